@@ -1,13 +1,21 @@
-#version 460 core
+#version 450 core
+// THERMAL  backgrounds as flat luminance
 
 out vec4 FragColor;
 
 in vec2 texPos;
+flat in int background;
 
-uniform sampler2D tex;
+// unit 0 holds the material array
+layout (binding = 1) uniform sampler2DArray tex;
 
 void main()
 {
-   vec3 col = texture(tex, texPos).rgb;
+   vec3 col = texture(tex, vec3(texPos, background)).rgb;
+#ifdef THERMAL
+   float lum = dot(col, vec3(0.15));
+   FragColor = vec4(vec3(lum), 1.0);
+#else
    FragColor = vec4(col, 1.0);
-}
\ No newline at end of file
+#endif
+}
@@ -1,11 +1,32 @@
-#version 460 core
+#version 450 core
+// LAYERED  one quad per instance, each written to its own layer
+
+#ifdef LAYERED
+#extension GL_ARB_shader_viewport_layer_array : require
+#define MAX_QUADS 32
+#else
+#define MAX_QUADS 1
+#endif
 
 layout (location = 0) in vec2 aPos;
 
 out vec2 texPos;
+flat out int background;
+
+// per quad: x the layer of the background array it shows, y the layer
+// it is drawn to
+layout (std140) uniform Quads {
+    ivec4 quads[MAX_QUADS];
+};
 
 void main()
 {
+   ivec4 quad = quads[gl_InstanceID];
+
    texPos = (aPos.xy + 1.0) / 2.0;
+   background = quad.x;
+#ifdef LAYERED
+   gl_Layer = quad.y;
+#endif
    gl_Position = vec4(aPos.x, aPos.y, 1.0, 1.0);
-}
\ No newline at end of file
+}
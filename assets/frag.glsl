@@ -1,36 +1,103 @@
-#version 330 core
+#version 450 core
+// THERMAL       thermal camera look on an untextured surface
+// TEXTURED      base color from the material texture array
+// UNLIT         base color only, no lighting
+// MASK_OUTPUT   white wherever the object is
+// DEPTH_OUTPUT  eye distance over the far plane distance as grey
+
 out vec4 FragColor;
 
-in vec3 Normal;  
-in vec3 FragPos;  
+in vec3 Normal;
+in vec3 FragPos;
 in vec2 fragTexPos;
+flat in int material;
 
-uniform sampler2D tex;
+#ifdef TEXTURED
+uniform sampler2DArray tex;
+#endif
 
+#ifdef DEPTH_OUTPUT
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
 
-void main()
+// inverts the perspective depth mapping with the projection's own terms
+float linear_depth()
+{
+    float a = projection[2][2];
+    float b = projection[3][2];
+    float z = gl_FragCoord.z * 2.0 - 1.0;
+
+    return (b / (a + z)) / (b / (a + 1.0));
+}
+#endif
+
+#ifdef THERMAL
+const vec3 lightPos = vec3(0.0, 5.0, 0.0);
+const vec3 viewPos = vec3(0.0, 5.0, 0.0);
+#else
+const vec3 lightPos = vec3(5.0, 5.0, 5.0);
+const vec3 viewPos = vec3(3.0, 3.0, 3.0);
+#endif
+const vec3 lightColor = vec3(1.0, 1.0, 1.0);
+
+#ifdef THERMAL
+vec3 thermal(vec3 c)
+{
+    vec3 result;
+    float luminance = 0.299 * c.r + 0.587 * c.g + 0.114 * c.b;
+    float THRESHOLD = 0.3;
+    result = (luminance < THRESHOLD) ? mix(vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 1.0), luminance * 2.0 ) : mix(vec3(0.0, 1.0, 1.0), vec3(1.0, 0.0, 0.0), (luminance - 0.5) * 2.0);
+    result *= 0.1 + 0.25 + 0.75 * pow( 16.0 * fragTexPos.x * fragTexPos.y * (1.0 - fragTexPos.x) * (1.0 - fragTexPos.y), 0.15 );
+    return vec3(pow(0.299 * result.r + 0.587 * result.g + 0.114 * result.b, 2.2));
+}
+#endif
+
+vec3 phong()
 {
-    vec3 lightPos = vec3(5.0, 5.0, 5.0); 
-    vec3 viewPos = vec3(3.0, 3.0, 3.0); 
-    vec3 lightColor = vec3(1.0, 1.0, 1.0);
-    vec3 objectColor = vec3(1.0, 0.5, 0.31);
     // ambient
     float ambientStrength = 0.1;
     vec3 ambient = ambientStrength * lightColor;
-  	
+
     // diffuse 
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(lightPos - FragPos);
     float diff = max(dot(norm, lightDir), 0.1);
     vec3 diffuse = diff * lightColor;
-    
+
     // specular
     float specularStrength = 0.5;
     vec3 viewDir = normalize(viewPos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * lightColor;  
-        
-    vec3 result = (ambient + diffuse + specular) * texture(tex, fragTexPos).xyz;
+
+    return ambient + diffuse + specular;
+}
+
+void main()
+{
+#if defined(MASK_OUTPUT)
+    FragColor = vec4(1.0);
+#elif defined(DEPTH_OUTPUT)
+    FragColor = vec4(vec3(linear_depth()), 1.0);
+#else
+#ifdef TEXTURED
+    vec3 base = texture(tex, vec3(fragTexPos, material)).xyz;
+#else
+    vec3 base = vec3(0.7);
+#endif
+
+#ifdef UNLIT
+    vec3 result = base;
+#else
+    vec3 result = phong() * base;
+#endif
+
+#ifdef THERMAL
+    result = thermal(result);
+#endif
     FragColor = vec4(result, 1.0);
-} 
\ No newline at end of file
+#endif
+}
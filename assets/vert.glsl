@@ -1,20 +1,72 @@
-#version 330 core
+#version 450 core
+// LAYERED           one pose per instance, each written to its own layer
+// COMPACT_VERTICES  quantized positions, octahedral normals, see compact_vertex
+
+#ifdef LAYERED
+#extension GL_ARB_shader_viewport_layer_array : require
+#define MAX_INSTANCES 32
+#else
+#define MAX_INSTANCES 1
+#endif
+
+#ifdef COMPACT_VERTICES
+layout (location = 0) in vec3 aQuantPos;
+layout (location = 2) in vec2 aOctNormal;
+
+uniform vec3 quant_offset;
+uniform vec3 quant_scale;
+
+vec3 oct_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+#else
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 texPos;
 layout (location = 2) in vec3 aNormal;
+#endif
+layout (location = 1) in vec2 texPos;
+layout (location = 3) in int aMaterial;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 fragTexPos;
+flat out int material;
+
+struct Instance {
+    mat4 model;
+    mat4 normal; // transpose(inverse(model)), computed on the CPU
+};
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Models {
+    Instance instances[MAX_INSTANCES];
+};
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
 
 void main()
 {
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
-    
+#ifdef LAYERED
+    Instance inst = instances[gl_InstanceID];
+    gl_Layer = gl_InstanceID;
+#else
+    Instance inst = instances[0];
+#endif
+
+#ifdef COMPACT_VERTICES
+    vec3 aPos = quant_offset + aQuantPos * quant_scale;
+    vec3 aNormal = oct_decode(aOctNormal);
+#endif
+
+    FragPos = vec3(inst.model * vec4(aPos, 1.0));
+    Normal = mat3(inst.normal) * aNormal;
+
     fragTexPos = texPos;
-    gl_Position = (projection * view * model) * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    material = aMaterial;
+    gl_Position = (projection * view * inst.model) * vec4(aPos, 1.0);
+}
@@ -0,0 +1,64 @@
+#include "annotation.h"
+
+#include <float.h>
+
+#define SPOS(w, x) ((w/2.0)*(1 + x))
+
+void annotation_compute(annotation *a, const float *bound_box, int w, int h, mat4 model, mat4 view, mat4 proj)
+{
+    mat4 mv, mvp;
+    vec4 centroid = {0, 0, 0, 1};
+    float min[2], max[2];
+
+    min[0] = min[1] = FLT_MAX;
+    max[0] = max[1] = -FLT_MAX;
+
+    glm_mat4_mul(view, model, mv);
+    glm_mat4_mul(proj, mv, mvp);
+
+    for (int i = 0; i < 8; i++) {
+        vec4 vert, result;
+        vec2 screen;
+
+        vert[0] = bound_box[i*4];
+        vert[1] = bound_box[i*4+1];
+        vert[2] = bound_box[i*4+2];
+        vert[3] = bound_box[i*4+3];
+
+        centroid[0] += vert[0] / 8.0f;
+        centroid[1] += vert[1] / 8.0f;
+        centroid[2] += vert[2] / 8.0f;
+
+        glm_mat4_mulv(mvp, vert, result);
+
+        a->keypoints[i][0] = SPOS(w, result[0] / result[3]);
+        a->keypoints[i][1] = SPOS(h, result[1] / result[3]);
+
+        // bndbox keeps its historical 6% shrink
+        screen[0] = result[0] / (result[3]*1.06);
+        screen[1] = result[1] / (result[3]*1.06);
+
+        min[0] = min[0] < screen[0] ? min[0] : screen[0];
+        min[1] = min[1] < screen[1] ? min[1] : screen[1];
+        max[0] = max[0] > screen[0] ? max[0] : screen[0];
+        max[1] = max[1] > screen[1] ? max[1] : screen[1];
+    }
+
+    vec4 result;
+    glm_mat4_mulv(mvp, centroid, result);
+    a->keypoints[8][0] = SPOS(w, result[0] / result[3]);
+    a->keypoints[8][1] = SPOS(h, result[1] / result[3]);
+
+    a->xmin = (int)(SPOS(w, min[0]));
+    a->xmax = (int)(SPOS(w, max[0]));
+    a->ymin = (int)(SPOS(h, min[1]));
+    a->ymax = (int)(SPOS(h, max[1]));
+
+    glm_mat4_pick3(mv, a->rotation);
+    glm_vec3_copy(mv[3], a->translation);
+
+    a->intrinsics[0] = proj[0][0] * w / 2.0f;
+    a->intrinsics[1] = proj[1][1] * h / 2.0f;
+    a->intrinsics[2] = w / 2.0f;
+    a->intrinsics[3] = h / 2.0f;
+}
@@ -0,0 +1,25 @@
+#ifndef __ANNOTATION_H__
+#define __ANNOTATION_H__
+
+#include <cglm/cglm.h>
+
+// 8 bound_box corners followed by the box centroid
+#define ANNOTATION_KEYPOINTS 9
+
+typedef struct annotation {
+    int xmin, ymin, xmax, ymax;
+
+    // object to camera transform, GL convention (camera looks down -z)
+    mat3 rotation;
+    vec3 translation;
+
+    // fx, fy, cx, cy in pixels
+    vec4 intrinsics;
+
+    // pixel coordinates in the same frame as the bndbox
+    vec2 keypoints[ANNOTATION_KEYPOINTS];
+} annotation;
+
+void annotation_compute(annotation *a, const float *bound_box, int w, int h, mat4 model, mat4 view, mat4 proj);
+
+#endif
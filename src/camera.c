@@ -2,28 +2,117 @@
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <string.h>
 
-void camera_update(int w, int h, shader s, camera cam, mat4 view, mat4 proj)
+#include "glstate.h"
+
+void camera_matrices(int w, int h, camera cam, mat4 view, mat4 proj)
 {
-    glUseProgram(s);
-    
     glm_perspective(cam.fov, (float)w / (float)h, 0.1f, 100.0f, proj);
-    glUniformMatrix4fv(glGetUniformLocation(s, "projection"), 1, GL_FALSE, proj[0]);
 
     vec3 xd = {0, 0, 0};
     vec3 xd2 = {0, 0, 1};
 
     glm_lookat(cam.position, xd, xd2, view);
-    glUniformMatrix4fv(glGetUniformLocation(s, "view"), 1, GL_FALSE, view[0]);
+}
+
+void camera_model(vec3 rotation, mat4 mdl)
+{
+    glm_rotate_x(mdl, rotation[1], mdl);
+    glm_rotate_y(mdl, rotation[0], mdl);
+}
+
+float camera_pixel_size(int w, int h, camera cam, float radius)
+{
+    mat4 view, proj;
+
+    camera_matrices(w, h, cam, view, proj);
+
+    // no closer than the near plane
+    float distance = glm_vec3_norm(cam.position) - radius;
+    if (distance < 0.1f) {
+        distance = 0.1f;
+    }
+
+    // proj[1][1] is 1 / tan(fovy / 2)
+    return 2.0f * distance / (proj[1][1] * h);
+}
+
+// std140 layout of the Camera block
+struct camera_block {
+    mat4 view;
+    mat4 projection;
+};
+
+static uint32_t camera_ubo;
+static struct camera_block camera_uploaded;
+
+void camera_update(int w, int h, camera cam, mat4 view, mat4 proj)
+{
+    struct camera_block block;
 
+    camera_matrices(w, h, cam, view, proj);
+    glm_mat4_copy(view, block.view);
+    glm_mat4_copy(proj, block.projection);
+
+    if (!camera_ubo) {
+        glCreateBuffers(1, &camera_ubo);
+        glNamedBufferData(camera_ubo, sizeof(block), &block, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, SHADER_CAMERA_BINDING, camera_ubo);
+    }
+    else if (!memcmp(&block, &camera_uploaded, sizeof(block))) {
+        return;
+    }
+    else {
+        glNamedBufferSubData(camera_ubo, 0, sizeof(block), &block);
+    }
+
+    camera_uploaded = block;
 }
 
-void camera_transform_mesh(shader s, mesh m, mat4 mdl)
+// std140 layout of one Models block entry
+struct camera_instance {
+    mat4 model;
+    mat4 normal;
+};
+
+static void camera_upload_models(stream_buffer *sb, const shader *s, mat4 *models, int n)
 {
-    glUseProgram(s);
+    size_t size = sizeof(struct camera_instance) * n;
+    size_t offset;
+
+    if (s->models_size > (int)size) {
+        size = s->models_size;
+    }
 
-    glm_rotate_x(mdl, m.rotation[1], mdl);
-    glm_rotate_y(mdl, m.rotation[0], mdl);
+    struct camera_instance *dst = stream_alloc(sb, size, &offset);
+    if (!dst) {
+        return;
+    }
+
+    // once per instance here instead of once per vertex in the shader
+    for (int i = 0; i < n; i++) {
+        mat4 normal;
+
+        glm_mat4_copy(models[i], dst[i].model);
+        glm_mat4_inv(models[i], normal);
+        glm_mat4_transpose_to(normal, dst[i].normal);
+    }
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, SHADER_MODELS_BINDING, sb->buffer, offset, size);
+}
 
-    glUniformMatrix4fv(glGetUniformLocation(s, "model"), 1, GL_FALSE, mdl[0]);
-}
\ No newline at end of file
+void camera_transform_mesh(stream_buffer *sb, const shader *s, const mesh *m, mat4 mdl)
+{
+    vec3 rotation;
+
+    glm_vec3_copy((float *)m->rotation, rotation);
+    camera_model(rotation, mdl);
+
+    camera_upload_models(sb, s, (mat4 *)mdl, 1);
+}
+
+void camera_transform_instances(stream_buffer *sb, const shader *s, mat4 *models, int n)
+{
+    camera_upload_models(sb, s, models, n);
+}
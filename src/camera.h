@@ -4,6 +4,7 @@
 #include <cglm/cglm.h>
 #include "mesh.h"
 #include "shader.h"
+#include "stream.h"
 
 typedef struct camera {
     vec3 position;
@@ -12,7 +13,18 @@ typedef struct camera {
     float fov;
 } camera;
 
-void camera_update(int w, int h, shader s, camera cam, mat4 view, mat4 proj);
-void camera_transform_mesh(shader s, mesh m, mat4 mdl);
+// CPU only, no GL calls
+void camera_matrices(int w, int h, camera cam, mat4 view, mat4 proj);
+void camera_model(vec3 rotation, mat4 mdl);
+// model units one pixel covers at the front of a bounding sphere centred
+// on the rotation origin, from the camera distance and FOV
+float camera_pixel_size(int w, int h, camera cam, float radius);
+
+// view and projection go to the std140 Camera block shared by all programs,
+// uploaded only when they change
+void camera_update(int w, int h, camera cam, mat4 view, mat4 proj);
+// model matrices are written to the stream and bound to the Models block
+void camera_transform_mesh(stream_buffer *sb, const shader *s, const mesh *m, mat4 mdl);
+void camera_transform_instances(stream_buffer *sb, const shader *s, mat4 *models, int n);
 
 #endif
\ No newline at end of file
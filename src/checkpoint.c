@@ -0,0 +1,129 @@
+#include "checkpoint.h"
+#include "fileio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct checkpoint_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seed;
+    checkpoint_params params;
+    uint32_t frames;
+    uint32_t position;
+    uint32_t records;
+};
+
+static mrerror checkpoint_load(checkpoint *c)
+{
+    struct checkpoint_header h;
+    FILE *f;
+
+    f = fopen(c->path, "rb");
+    if (f == NULL) {
+        return mrerror_new("no checkpoint to resume from");
+    }
+
+    if (fread(&h, sizeof(h), 1, f) != 1 ||
+        h.magic != CHECKPOINT_MAGIC ||
+        h.version != CHECKPOINT_VERSION)
+    {
+        fclose(f);
+        return mrerror_new("bad checkpoint");
+    }
+
+    if (memcmp(h.params.grid, c->params.grid, sizeof(h.params.grid))) {
+        fclose(f);
+        return mrerror_new("checkpoint was made for different angles");
+    }
+    if (memcmp(&h.params, &c->params, sizeof(h.params)) || h.frames != c->frames) {
+        fclose(f);
+        return mrerror_new("checkpoint was made with different composites, sprite cache or filter");
+    }
+
+    if (fread(c->done, 1, (c->frames + 7)/8, f) != (c->frames + 7)/8) {
+        fclose(f);
+        return mrerror_new("truncated checkpoint");
+    }
+    fclose(f);
+
+    c->seed = h.seed;
+    c->position = h.position;
+    c->records = h.records;
+    c->done_num = 0;
+    for (uint32_t i = 0; i < c->frames; i++) {
+        c->done_num += checkpoint_done(c, i);
+    }
+
+    return nilerr();
+}
+
+mrerror checkpoint_open(checkpoint *c, const char *dir, uint64_t seed, const checkpoint_params *params, uint32_t frames, int resume)
+{
+    memset(c, 0, sizeof(checkpoint));
+
+    snprintf(c->path, sizeof(c->path), "%s/checkpoint.bin", dir);
+    c->seed = seed;
+    c->params = *params;
+    c->frames = frames;
+    c->done = calloc((frames + 7)/8 + 1, 1);
+
+    if (resume) {
+        mrerror err = checkpoint_load(c);
+        if (err.err) {
+            checkpoint_close(c);
+            return err;
+        }
+    }
+
+    return nilerr();
+}
+
+void checkpoint_close(checkpoint *c)
+{
+    free(c->done);
+    c->done = NULL;
+}
+
+int checkpoint_done(const checkpoint *c, uint32_t index)
+{
+    return (c->done[index/8] >> (index%8)) & 1;
+}
+
+void checkpoint_mark(checkpoint *c, uint32_t index)
+{
+    if (!checkpoint_done(c, index)) {
+        c->done[index/8] |= 1 << (index%8);
+        c->done_num++;
+    }
+    c->position = index + 1;
+}
+
+mrerror checkpoint_save(checkpoint *c)
+{
+    char tmp[1040];
+    struct checkpoint_header h = {
+        CHECKPOINT_MAGIC, CHECKPOINT_VERSION, c->seed,
+        c->params,
+        c->frames, c->position, c->records
+    };
+    FILE *f;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", c->path);
+    f = fopen(tmp, "wb");
+    if (f == NULL) {
+        return mrerror_new("can't write checkpoint");
+    }
+
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(c->done, 1, (c->frames + 7)/8, f);
+    fileio_sync(f);
+    fclose(f);
+
+    if (!fileio_replace(tmp, c->path)) {
+        return mrerror_new("can't replace checkpoint");
+    }
+
+    return nilerr();
+}
@@ -0,0 +1,45 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <stdint.h>
+
+#include "error.h"
+
+#define CHECKPOINT_MAGIC   0x4b43524d // "MRCK"
+#define CHECKPOINT_VERSION 3
+
+// Everything that decides which poses a run renders and how frame ids and
+// manifest records are derived from them. A resume has to match it exactly.
+typedef struct checkpoint_params {
+    int32_t grid[4];      // ys, ye, ps, pe
+    int32_t composites;   // frames per pose
+    int32_t compositing;  // objects put over backgrounds on the CPU
+    float   filter[3];    // min_area, max_truncation, max_aspect
+} checkpoint_params;
+
+// Progress of a run over its pose list. Every frame's rng stream is derived
+// from the run seed and the frame id, so the seed is all the rng state there is.
+typedef struct checkpoint {
+    char path[1024];
+
+    uint64_t seed;
+    checkpoint_params params;
+    uint32_t frames;
+    uint32_t position;  // next pose index in render order
+    uint32_t records;   // manifest records of the frames marked done
+    uint32_t done_num;
+    uint8_t *done;      // bitset by pose index
+} checkpoint;
+
+// with resume set an existing checkpoint for the same params is loaded and
+// its seed replaces the given one
+mrerror checkpoint_open(checkpoint *c, const char *dir, uint64_t seed, const checkpoint_params *params, uint32_t frames, int resume);
+void checkpoint_close(checkpoint *c);
+
+int  checkpoint_done(const checkpoint *c, uint32_t index);
+void checkpoint_mark(checkpoint *c, uint32_t index);
+
+// written to a temporary file and renamed over the previous one
+mrerror checkpoint_save(checkpoint *c);
+
+#endif
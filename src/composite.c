@@ -0,0 +1,131 @@
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define COMPOSITE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define COMPOSITE_NEON
+#endif
+
+#include "composite.h"
+
+// exact x / 255 rounded, for x <= 255 * 255
+static inline uint32_t div255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static void composite_pixels(uint8_t *d, const uint8_t *s, const uint8_t *b, int n)
+{
+    for (int x = 0; x < n; x++) {
+        uint32_t inv = 255 - s[x*4 + 3];
+
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = s[x*4 + c] + div255(inv * b[x*3 + c]);
+            d[x*3 + c] = v > 255 ? 255 : v;
+        }
+    }
+}
+
+#ifdef COMPOSITE_SSE2
+// div255 on 16 bit lanes, none of the sums overflow for x <= 255 * 255
+static inline __m128i div255_epu16(__m128i x)
+{
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// two pixels widened to 16 bits, over their background
+static inline __m128i over_epu16(__m128i s, __m128i b)
+{
+    // alpha into all four lanes of its pixel
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xff), 0xff);
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), a);
+
+    return _mm_add_epi16(s, div255_epu16(_mm_mullo_epi16(inv, b)));
+}
+
+// Four pixels per step. The 12 bytes of background RGB are spread to one
+// pixel per 32 bit lane by byte shifts, and the result packed back the same
+// way. The 16 byte background load reaches past the four pixels, so a step
+// needs two more pixels after it.
+static int composite_row(uint8_t *d, const uint8_t *s, const uint8_t *b, int w)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgb = _mm_set1_epi32(0x00ffffff);
+    const __m128i lane[4] = {
+        _mm_setr_epi32(-1, 0, 0, 0), _mm_setr_epi32(0, -1, 0, 0),
+        _mm_setr_epi32(0, 0, -1, 0), _mm_setr_epi32(0, 0, 0, -1),
+    };
+    int x = 0;
+
+    for (; x + 6 <= w; x += 4) {
+        __m128i src = _mm_loadu_si128((const __m128i *)(s + x*4));
+        __m128i packed = _mm_loadu_si128((const __m128i *)(b + x*3));
+
+        // pixel k moves from byte 3k to byte 4k
+        __m128i bg = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(packed, lane[0]), _mm_and_si128(_mm_slli_si128(packed, 1), lane[1])),
+            _mm_or_si128(_mm_and_si128(_mm_slli_si128(packed, 2), lane[2]), _mm_and_si128(_mm_slli_si128(packed, 3), lane[3])));
+
+        __m128i lo = over_epu16(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(bg, zero));
+        __m128i hi = over_epu16(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(bg, zero));
+
+        // saturates like the scalar clamp, then back from byte 4k to 3k
+        __m128i out = _mm_and_si128(_mm_packus_epi16(lo, hi), rgb);
+        out = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(out, lane[0]), _mm_srli_si128(_mm_and_si128(out, lane[1]), 1)),
+            _mm_or_si128(_mm_srli_si128(_mm_and_si128(out, lane[2]), 2), _mm_srli_si128(_mm_and_si128(out, lane[3]), 3)));
+
+        uint32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+        _mm_storel_epi64((__m128i *)(d + x*3), out);
+        memcpy(d + x*3 + 8, &tail, 4);
+    }
+
+    return x;
+}
+#elif defined(COMPOSITE_NEON)
+// eight pixels per step, deinterleaved by the structure loads
+static int composite_row(uint8_t *d, const uint8_t *s, const uint8_t *b, int w)
+{
+    int x = 0;
+
+    for (; x + 8 <= w; x += 8) {
+        uint8x8x4_t src = vld4_u8(s + x*4);
+        uint8x8x3_t bg = vld3_u8(b + x*3);
+        uint8x8x3_t out;
+        uint8x8_t inv = vsub_u8(vdup_n_u8(255), src.val[3]);
+
+        for (int c = 0; c < 3; c++) {
+            uint16x8_t v = vaddq_u16(vmull_u8(inv, bg.val[c]), vdupq_n_u16(128));
+
+            v = vaddq_u16(v, vshrq_n_u16(v, 8));
+            out.val[c] = vqadd_u8(src.val[c], vshrn_n_u16(v, 8));
+        }
+        vst3_u8(d + x*3, out);
+    }
+
+    return x;
+}
+#else
+static int composite_row(uint8_t *d, const uint8_t *s, const uint8_t *b, int w)
+{
+    return 0;
+}
+#endif
+
+void composite_over(uint8_t *dst, const uint8_t *src, int src_stride, const uint8_t *bg, int w, int h)
+{
+    for (int y = 0; y < h; y++) {
+        const uint8_t *s = src + (size_t)y * src_stride;
+        const uint8_t *b = bg + (size_t)y * w * 3;
+        uint8_t *d = dst + (size_t)y * w * 3;
+
+        // the vector path leaves the tail of the row
+        int x = composite_row(d, s, b, w);
+        composite_pixels(d + x*3, s + x*4, b + x*3, w - x);
+    }
+}
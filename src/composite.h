@@ -0,0 +1,14 @@
+#ifndef __COMPOSITE_H__
+#define __COMPOSITE_H__
+
+#include <stdint.h>
+
+// Puts a premultiplied RGBA render over an opaque RGB background:
+// dst = src + (1 - src.a) * bg. Rendering onto a transparent black clear
+// gives exactly such a premultiplied image, with the resolved alpha as
+// the MSAA coverage of the object.
+//
+// src rows are src_stride bytes apart, dst and bg are tightly packed.
+void composite_over(uint8_t *dst, const uint8_t *src, int src_stride, const uint8_t *bg, int w, int h);
+
+#endif
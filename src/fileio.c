@@ -0,0 +1,36 @@
+#include "fileio.h"
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+# include <windows.h>
+# include <io.h>
+# include <process.h>
+# define getpid _getpid
+#else
+# include <unistd.h>
+#endif
+
+int fileio_replace(const char *from, const char *to)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+void fileio_temp_path(char *buf, size_t size, const char *path)
+{
+    snprintf(buf, size, "%s.%d.tmp", path, (int)getpid());
+}
+
+int fileio_sync(FILE *f)
+{
+    if (fflush(f)) {
+        return 0;
+    }
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    return FlushFileBuffers((HANDLE)_get_osfhandle(_fileno(f))) != 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
@@ -0,0 +1,17 @@
+#ifndef __FILEIO_H__
+#define __FILEIO_H__
+
+#include <stdio.h>
+
+// renames from over to, replacing any existing file in one step so readers
+// see either the old or the new contents; nonzero on success
+int fileio_replace(const char *from, const char *to);
+
+// path with the process id and .tmp appended, so concurrent runs writing the
+// same file never share a temporary
+void fileio_temp_path(char *buf, size_t size, const char *path);
+
+// flushes f down to the disk, nonzero on success
+int fileio_sync(FILE *f);
+
+#endif
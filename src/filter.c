@@ -0,0 +1,73 @@
+#include "filter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+mrerror filter_parse(frame_filter *f, const char *arg)
+{
+    char key[16];
+    float value;
+    int len;
+
+    while (sscanf(arg, "%15[a-z]=%f%n", key, &value, &len) == 2) {
+        if (value < 0 || (!strcmp(key, "trunc") && value > 1)) {
+            return mrerror_new("filter value out of range");
+        }
+
+        if (!strcmp(key, "area")) {
+            f->min_area = value;
+        }
+        else if (!strcmp(key, "trunc")) {
+            f->max_truncation = value;
+        }
+        else if (!strcmp(key, "aspect")) {
+            f->max_aspect = value;
+        }
+        else {
+            break;
+        }
+
+        arg += len;
+        if (*arg != ',') {
+            break;
+        }
+        arg++;
+    }
+
+    if (*arg) {
+        return mrerror_new("filter must be area=px,trunc=fraction,aspect=ratio");
+    }
+
+    return nilerr();
+}
+
+int filter_enabled(const frame_filter *f)
+{
+    return f->min_area > 0 || f->max_truncation < 1 || f->max_aspect > 0;
+}
+
+int filter_accept(const frame_filter *f, const annotation *a, int w, int h)
+{
+    float bw = a->xmax - a->xmin;
+    float bh = a->ymax - a->ymin;
+
+    // the bndbox clipped to the frame
+    float vw = (a->xmax < w ? a->xmax : w) - (a->xmin > 0 ? a->xmin : 0);
+    float vh = (a->ymax < h ? a->ymax : h) - (a->ymin > 0 ? a->ymin : 0);
+
+    if (bw <= 0 || bh <= 0 || vw <= 0 || vh <= 0) {
+        return 0;
+    }
+
+    if (f->min_area > 0 && vw * vh < f->min_area) {
+        return 0;
+    }
+    if (1.0f - (vw * vh) / (bw * bh) > f->max_truncation) {
+        return 0;
+    }
+    if (f->max_aspect > 0 && (vw > vh ? vw / vh : vh / vw) > f->max_aspect) {
+        return 0;
+    }
+
+    return 1;
+}
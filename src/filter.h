@@ -0,0 +1,23 @@
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include "error.h"
+#include "annotation.h"
+
+// Acceptance rules for a pose, judged on its projected bndbox before
+// anything is rendered. FILTER_NONE accepts everything.
+typedef struct frame_filter {
+    float min_area;       // pixels inside the frame, 0 is off
+    float max_truncation; // fraction of the box outside the frame, 1 is off
+    float max_aspect;     // long side over short side of the visible box, 0 is off
+} frame_filter;
+
+#define FILTER_NONE ((frame_filter){.min_area = 0, .max_truncation = 1, .max_aspect = 0})
+
+// comma separated area=px, trunc=fraction and aspect=ratio
+mrerror filter_parse(frame_filter *f, const char *arg);
+
+int filter_enabled(const frame_filter *f);
+int filter_accept(const frame_filter *f, const annotation *a, int w, int h);
+
+#endif
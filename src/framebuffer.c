@@ -0,0 +1,225 @@
+#include "framebuffer.h"
+
+#include <glad/glad.h>
+#include <string.h>
+
+static mrerror framebuffer_check(framebuffer *fb)
+{
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        framebuffer_free(fb);
+        return mrerror_new("framebuffer incomplete");
+    }
+    return nilerr();
+}
+
+mrerror framebuffer_new(framebuffer *fb, int w, int h, int samples)
+{
+    int max_samples;
+    mrerror err;
+
+    memset(fb, 0, sizeof(framebuffer));
+
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    if (samples > max_samples) {
+        samples = max_samples;
+    }
+    if (samples < 0) {
+        samples = 0;
+    }
+
+    fb->w = w;
+    fb->h = h;
+    fb->samples = samples;
+
+    glGenFramebuffers(1, &fb->fbo);
+    glGenRenderbuffers(1, &fb->color);
+    glGenRenderbuffers(1, &fb->depth);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, fb->color);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, fb->depth);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, w, h);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fb->fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, fb->color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, fb->depth);
+
+    err = framebuffer_check(fb);
+    if (err.err) {
+        return err;
+    }
+
+    if (samples == 0) {
+        fb->resolve_fbo = fb->fbo;
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        return nilerr();
+    }
+
+    glGenFramebuffers(1, &fb->resolve_fbo);
+    glGenRenderbuffers(1, &fb->resolve_color);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, fb->resolve_color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fb->resolve_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, fb->resolve_color);
+
+    err = framebuffer_check(fb);
+    if (err.err) {
+        return err;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fb->fbo);
+    return nilerr();
+}
+
+static uint32_t layered_texture(int w, int h, int samples, int layers, GLenum format)
+{
+    uint32_t t;
+
+    if (samples) {
+        glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, 1, &t);
+        glTextureStorage3DMultisample(t, samples, format, w, h, layers, GL_TRUE);
+    }
+    else {
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &t);
+        glTextureStorage3D(t, 1, format, w, h, layers);
+    }
+
+    return t;
+}
+
+mrerror framebuffer_new_layered(framebuffer *fb, int w, int h, int samples, int layers)
+{
+    int max_samples, max_layers;
+
+    memset(fb, 0, sizeof(framebuffer));
+
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    samples = samples > max_samples ? max_samples : samples;
+    samples = samples < 0 ? 0 : samples;
+    if (layers > max_layers) {
+        return mrerror_new("too many layers");
+    }
+
+    fb->w = w;
+    fb->h = h;
+    fb->samples = samples;
+    fb->layers = layers;
+
+    fb->color = layered_texture(w, h, samples, layers, GL_RGBA8);
+    fb->depth = layered_texture(w, h, samples, layers, GL_DEPTH_COMPONENT24);
+
+    glGenFramebuffers(1, &fb->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fb->fbo);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, fb->color, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, fb->depth, 0);
+
+    mrerror err = framebuffer_check(fb);
+    if (err.err) {
+        return err;
+    }
+
+    if (samples) {
+        fb->resolve_color = layered_texture(w, h, 0, layers, GL_RGBA8);
+        glGenFramebuffers(1, &fb->blit_fbo);
+        glGenFramebuffers(1, &fb->resolve_fbo);
+    }
+    else {
+        fb->resolve_color = fb->color;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fb->fbo);
+    return nilerr();
+}
+
+void framebuffer_bind(framebuffer *fb)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fb ? fb->fbo : 0);
+}
+
+void framebuffer_resolve(framebuffer *fb)
+{
+    if (fb->layers) {
+        if (!fb->samples) {
+            return;
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fb->blit_fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fb->resolve_fbo);
+        for (int i = 0; i < fb->layers; i++) {
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, fb->color, 0, i);
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, fb->resolve_color, 0, i);
+            glBlitFramebuffer(0, 0, fb->w, fb->h, 0, 0, fb->w, fb->h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        return;
+    }
+
+    if (fb->resolve_fbo != fb->fbo) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fb->fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fb->resolve_fbo);
+        glBlitFramebuffer(0, 0, fb->w, fb->h, 0, 0, fb->w, fb->h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fb->resolve_fbo);
+}
+
+void framebuffer_read_layers(framebuffer *fb, int n, int channels, uint8_t *data)
+{
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureSubImage(fb->resolve_color, 0, 0, 0, 0, fb->w, fb->h, n,
+                         channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE,
+                         (size_t)fb->w * fb->h * channels * n, data);
+}
+
+void framebuffer_present(framebuffer *fb, int w, int h)
+{
+    if (fb->layers) {
+        // only layer 0 is shown
+        if (!fb->samples) {
+            if (!fb->blit_fbo) {
+                glGenFramebuffers(1, &fb->blit_fbo);
+            }
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, fb->blit_fbo);
+        }
+        else {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, fb->resolve_fbo);
+        }
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, fb->resolve_color, 0, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        return;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fb->resolve_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+void framebuffer_free(framebuffer *fb)
+{
+    if (fb->layers) {
+        if (fb->resolve_color != fb->color) {
+            glDeleteTextures(1, &fb->resolve_color);
+        }
+        glDeleteTextures(1, &fb->color);
+        glDeleteTextures(1, &fb->depth);
+        glDeleteFramebuffers(1, &fb->fbo);
+        glDeleteFramebuffers(1, &fb->blit_fbo);
+        glDeleteFramebuffers(1, &fb->resolve_fbo);
+        memset(fb, 0, sizeof(framebuffer));
+        return;
+    }
+
+    if (fb->resolve_fbo != fb->fbo) {
+        glDeleteFramebuffers(1, &fb->resolve_fbo);
+        glDeleteRenderbuffers(1, &fb->resolve_color);
+    }
+    glDeleteFramebuffers(1, &fb->fbo);
+    glDeleteRenderbuffers(1, &fb->color);
+    glDeleteRenderbuffers(1, &fb->depth);
+    memset(fb, 0, sizeof(framebuffer));
+}
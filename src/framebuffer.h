@@ -0,0 +1,44 @@
+#ifndef __FRAMEBUFFER_H__
+#define __FRAMEBUFFER_H__
+
+#include <stdint.h>
+
+#include "error.h"
+
+// Draws go to fbo, multisampled when samples > 0. framebuffer_resolve blits
+// it into the single sampled resolve_fbo that readback uses; without MSAA
+// both are the same object and resolving is free.
+//
+// A layered framebuffer keeps color and depth in texture arrays with one
+// layer per view, selected with gl_Layer. Layers are resolved one at a time
+// through blit_fbo and resolve_fbo.
+typedef struct framebuffer {
+    uint32_t fbo;
+    uint32_t color, depth;
+
+    uint32_t resolve_fbo;
+    uint32_t resolve_color;
+
+    uint32_t blit_fbo;
+
+    int w, h;
+    int samples;
+    int layers;
+} framebuffer;
+
+mrerror framebuffer_new(framebuffer *fb, int w, int h, int samples);
+mrerror framebuffer_new_layered(framebuffer *fb, int w, int h, int samples, int layers);
+void framebuffer_bind(framebuffer *fb);
+void framebuffer_free(framebuffer *fb);
+
+// leaves the resolved image bound as GL_READ_FRAMEBUFFER
+void framebuffer_resolve(framebuffer *fb);
+
+// reads the first n resolved layers tightly packed, layer after layer,
+// as RGB or RGBA for 3 or 4 channels
+void framebuffer_read_layers(framebuffer *fb, int n, int channels, uint8_t *data);
+
+// copies the bottom left w x h of the resolved image to the window
+void framebuffer_present(framebuffer *fb, int w, int h);
+
+#endif
@@ -0,0 +1,123 @@
+#include "glstate.h"
+
+#include <glad/glad.h>
+
+#define GLSTATE_UNITS   16
+#define GLSTATE_UNKNOWN 0xffffffffu
+
+enum { TARGET_2D, TARGET_2D_ARRAY, TARGET_NUM };
+enum { BUFFER_ARRAY, BUFFER_DRAW_INDIRECT, BUFFER_NUM };
+
+static struct {
+    uint32_t program;
+    uint32_t vao;
+    uint32_t active_unit;
+    uint32_t textures[GLSTATE_UNITS][TARGET_NUM];
+    uint32_t buffers[BUFFER_NUM];
+    int      initialized;
+} state;
+
+static glstate_counters counters;
+
+// GLSTATE_UNKNOWN never matches a real name, so the next bind always goes through
+void glstate_reset(void)
+{
+    state.program = GLSTATE_UNKNOWN;
+    state.vao = GLSTATE_UNKNOWN;
+    state.active_unit = GLSTATE_UNKNOWN;
+    for (int i = 0; i < GLSTATE_UNITS; i++) {
+        for (int t = 0; t < TARGET_NUM; t++) {
+            state.textures[i][t] = GLSTATE_UNKNOWN;
+        }
+    }
+    for (int b = 0; b < BUFFER_NUM; b++) {
+        state.buffers[b] = GLSTATE_UNKNOWN;
+    }
+    state.initialized = 1;
+}
+
+// 1 when the call has to be issued, updating the shadow value
+static int changes(uint32_t *shadow, uint32_t value)
+{
+    if (!state.initialized) {
+        glstate_reset();
+    }
+
+    if (*shadow == value) {
+        counters.elided++;
+        return 0;
+    }
+
+    *shadow = value;
+    counters.issued++;
+    return 1;
+}
+
+void glstate_use_program(uint32_t program)
+{
+    if (changes(&state.program, program)) {
+        glUseProgram(program);
+    }
+}
+
+void glstate_bind_vertex_array(uint32_t vao)
+{
+    if (changes(&state.vao, vao)) {
+        glBindVertexArray(vao);
+    }
+}
+
+void glstate_bind_texture(uint32_t unit, uint32_t target, uint32_t texture)
+{
+    int t;
+
+    switch (target) {
+    case GL_TEXTURE_2D:       t = TARGET_2D; break;
+    case GL_TEXTURE_2D_ARRAY: t = TARGET_2D_ARRAY; break;
+    default:                  t = -1; break;
+    }
+
+    if (t < 0 || unit >= GLSTATE_UNITS) {
+        if (changes(&state.active_unit, unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+        counters.issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+
+    // the active unit only moves for binds that are issued, so units that
+    // keep their textures can alternate between draws for free
+    if (changes(&state.textures[unit][t], texture)) {
+        if (changes(&state.active_unit, unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+        glBindTexture(target, texture);
+    }
+}
+
+void glstate_bind_buffer(uint32_t target, uint32_t buffer)
+{
+    int b;
+
+    switch (target) {
+    case GL_ARRAY_BUFFER:         b = BUFFER_ARRAY; break;
+    case GL_DRAW_INDIRECT_BUFFER: b = BUFFER_DRAW_INDIRECT; break;
+    default:                      b = -1; break;
+    }
+
+    if (b < 0) {
+        counters.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+
+    if (changes(&state.buffers[b], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+glstate_counters glstate_get_counters(void)
+{
+    return counters;
+}
@@ -0,0 +1,27 @@
+#ifndef __GLSTATE_H__
+#define __GLSTATE_H__
+
+#include <stdint.h>
+
+// Shadow copy of the binding state the renderer touches, so binds that
+// would not change anything never reach the driver. Every program, VAO,
+// texture and buffer bind has to go through here for the shadow to stay
+// right; call glstate_reset after anything else changes bindings.
+//
+// Element array bindings are VAO state and are passed straight through.
+
+typedef struct glstate_counters {
+    uint64_t issued;
+    uint64_t elided;
+} glstate_counters;
+
+void glstate_reset(void);
+
+void glstate_use_program(uint32_t program);
+void glstate_bind_vertex_array(uint32_t vao);
+void glstate_bind_texture(uint32_t unit, uint32_t target, uint32_t texture);
+void glstate_bind_buffer(uint32_t target, uint32_t buffer);
+
+glstate_counters glstate_get_counters(void);
+
+#endif
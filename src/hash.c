@@ -0,0 +1,12 @@
+#include "hash.h"
+
+uint64_t hash_bytes(uint64_t h, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
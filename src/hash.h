@@ -0,0 +1,12 @@
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_SEED 0xcbf29ce484222325ull
+
+// 64 bit FNV-1a over size bytes, continuing from h; start from HASH_SEED
+uint64_t hash_bytes(uint64_t h, const void *data, size_t size);
+
+#endif
@@ -0,0 +1,239 @@
+#include "imageset.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "rng.h"
+
+#define WRITER_BUFSIZE (1 << 20)
+
+enum {
+    LIST_TEST,
+    LIST_TRAIN,
+    LIST_TRAINVAL,
+    LIST_VAL,
+    LIST_COUNT
+};
+
+static const char *list_names[LIST_COUNT] = {
+    "test.txt", "train.txt", "trainval.txt", "val.txt"
+};
+
+mrerror imageset_parse_ratios(imageset_config *cfg, const char *arg)
+{
+    float train, val, test;
+
+    if (sscanf(arg, "%f:%f:%f", &train, &val, &test) != 3 ||
+        train < 0 || val < 0 || test < 0 ||
+        train + val + test <= 0)
+    {
+        return mrerror_new("split ratios must be train:val:test");
+    }
+
+    cfg->train = train;
+    cfg->val = val;
+    cfg->test = test;
+
+    return nilerr();
+}
+
+mrerror imageset_parse_stratify(imageset_config *cfg, const char *arg)
+{
+    char mode[16] = {0};
+    int bucket = cfg->bucket;
+
+    if (sscanf(arg, "%15[a-z]:%d", mode, &bucket) < 1 || bucket <= 0) {
+        return mrerror_new("stratify must be none|yaw|pitch|pose[:degrees]");
+    }
+
+    if (!strcmp(mode, "none")) {
+        cfg->stratify = IMAGESET_STRATIFY_NONE;
+    }
+    else if (!strcmp(mode, "yaw")) {
+        cfg->stratify = IMAGESET_STRATIFY_YAW;
+    }
+    else if (!strcmp(mode, "pitch")) {
+        cfg->stratify = IMAGESET_STRATIFY_PITCH;
+    }
+    else if (!strcmp(mode, "pose")) {
+        cfg->stratify = IMAGESET_STRATIFY_POSE;
+    }
+    else {
+        return mrerror_new("stratify must be none|yaw|pitch|pose[:degrees]");
+    }
+
+    cfg->bucket = bucket;
+    return nilerr();
+}
+
+struct writer {
+    FILE *f;
+    size_t len;
+    char *buf;
+};
+
+static void writer_flush(struct writer *w)
+{
+    fwrite(w->buf, 1, w->len, w->f);
+    w->len = 0;
+}
+
+static void writer_put_id(struct writer *w, uint32_t id)
+{
+    char tmp[12];
+    int i = sizeof(tmp);
+
+    if (w->len + sizeof(tmp) > WRITER_BUFSIZE) {
+        writer_flush(w);
+    }
+
+    tmp[--i] = '\n';
+    do {
+        tmp[--i] = '0' + id % 10;
+        id /= 10;
+    } while (id);
+
+    memcpy(w->buf + w->len, tmp + i, sizeof(tmp) - i);
+    w->len += sizeof(tmp) - i;
+}
+
+static int bucket_of(float angle, int bucket)
+{
+    return (int)floorf(angle / bucket);
+}
+
+// dense stratum index per pose, returns the number of strata
+static uint32_t stratify(const pose *poses, int count, imageset_config cfg, uint32_t *keys)
+{
+    int use_yaw = cfg.stratify == IMAGESET_STRATIFY_YAW || cfg.stratify == IMAGESET_STRATIFY_POSE;
+    int use_pitch = cfg.stratify == IMAGESET_STRATIFY_PITCH || cfg.stratify == IMAGESET_STRATIFY_POSE;
+    int ymin = 0, ymax = 0, pmin = 0, pmax = 0;
+
+    for (int i = 0; i < count; i++) {
+        int yb = use_yaw ? bucket_of(poses[i].yaw, cfg.bucket) : 0;
+        int pb = use_pitch ? bucket_of(poses[i].pitch, cfg.bucket) : 0;
+
+        if (i == 0 || yb < ymin) ymin = yb;
+        if (i == 0 || yb > ymax) ymax = yb;
+        if (i == 0 || pb < pmin) pmin = pb;
+        if (i == 0 || pb > pmax) pmax = pb;
+    }
+
+    uint32_t pitch_num = pmax - pmin + 1;
+
+    for (int i = 0; i < count; i++) {
+        int yb = use_yaw ? bucket_of(poses[i].yaw, cfg.bucket) : 0;
+        int pb = use_pitch ? bucket_of(poses[i].pitch, cfg.bucket) : 0;
+
+        keys[i] = (yb - ymin) * pitch_num + (pb - pmin);
+    }
+
+    return (ymax - ymin + 1) * pitch_num;
+}
+
+mrerror imageset_split(const char *dir, const pose *poses, int count, imageset_config cfg)
+{
+    char filename[512];
+    struct writer lists[LIST_COUNT] = {0};
+    mrerror err = nilerr();
+    rng r;
+
+    float total = cfg.train + cfg.val + cfg.test;
+
+    uint32_t *order = malloc(count * sizeof(uint32_t));
+    uint32_t *keys = malloc(count * sizeof(uint32_t));
+    if (count && (!order || !keys)) {
+        free(order);
+        free(keys);
+        return mrerror_new("malloc error");
+    }
+
+    // Fisher-Yates, one unbiased draw per element
+    rng_seed(&r, cfg.seed);
+    for (int i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    for (int i = count - 1; i > 0; i--) {
+        uint32_t j = rng_range(&r, i + 1);
+        uint32_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+
+    uint32_t strata = count ? stratify(poses, count, cfg, keys) : 0;
+    uint32_t *seen = calloc(strata + 1, sizeof(uint32_t));
+    uint32_t *test_num = calloc(strata + 1, sizeof(uint32_t));
+    uint32_t *val_num = calloc(strata + 1, sizeof(uint32_t));
+
+    for (int i = 0; i < count; i++) {
+        seen[keys[i]]++;
+    }
+
+    // cumulative rounding keeps the global shares exact across strata
+    uint64_t cum = 0, test_cum = 0, val_cum = 0;
+    for (uint32_t s = 0; s < strata; s++) {
+        cum += seen[s];
+
+        uint64_t test_target = llround(cum * (double)cfg.test / total);
+        uint64_t val_target = llround(cum * (double)cfg.val / total);
+
+        test_num[s] = test_target - test_cum;
+        val_num[s] = val_target - val_cum;
+        if (test_num[s] + val_num[s] > seen[s]) {
+            val_num[s] = seen[s] - test_num[s];
+        }
+
+        test_cum += test_num[s];
+        val_cum += val_num[s];
+        seen[s] = 0;
+    }
+
+    for (int l = 0; l < LIST_COUNT; l++) {
+        snprintf(filename, sizeof(filename), "%s/%s", dir, list_names[l]);
+        lists[l].f = fopen(filename, "w");
+        if (lists[l].f == NULL) {
+            err = mrerror_new("can't open imageset list");
+            goto out;
+        }
+        lists[l].buf = malloc(WRITER_BUFSIZE);
+    }
+
+    // the first test_num/val_num members of each stratum in shuffled order
+    // form a uniform random subset of it, so one pass assigns everything
+    for (int i = 0; i < count; i++) {
+        uint32_t p = order[i];
+        uint32_t s = keys[p];
+        uint32_t k = seen[s]++;
+
+        if (k < test_num[s]) {
+            writer_put_id(&lists[LIST_TEST], poses[p].id);
+        }
+        else if (k < test_num[s] + val_num[s]) {
+            writer_put_id(&lists[LIST_VAL], poses[p].id);
+            writer_put_id(&lists[LIST_TRAINVAL], poses[p].id);
+        }
+        else {
+            writer_put_id(&lists[LIST_TRAIN], poses[p].id);
+            writer_put_id(&lists[LIST_TRAINVAL], poses[p].id);
+        }
+    }
+
+out:
+    for (int l = 0; l < LIST_COUNT; l++) {
+        if (lists[l].f) {
+            writer_flush(&lists[l]);
+            fclose(lists[l].f);
+        }
+        free(lists[l].buf);
+    }
+
+    free(val_num);
+    free(test_num);
+    free(seen);
+    free(keys);
+    free(order);
+
+    return err;
+}
@@ -0,0 +1,29 @@
+#ifndef __IMAGESET_H__
+#define __IMAGESET_H__
+
+#include <stdint.h>
+
+#include "error.h"
+#include "pose.h"
+
+enum {
+    IMAGESET_STRATIFY_NONE,
+    IMAGESET_STRATIFY_YAW,
+    IMAGESET_STRATIFY_PITCH,
+    IMAGESET_STRATIFY_POSE,
+};
+
+typedef struct imageset_config {
+    float train, val, test; // relative weights
+    int stratify;
+    int bucket;             // degrees per stratum
+    uint64_t seed;
+} imageset_config;
+
+mrerror imageset_parse_ratios(imageset_config *cfg, const char *arg);
+mrerror imageset_parse_stratify(imageset_config *cfg, const char *arg);
+
+// writes train, val, trainval and test lists for poses into dir
+mrerror imageset_split(const char *dir, const pose *poses, int count, imageset_config cfg);
+
+#endif
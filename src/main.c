@@ -13,6 +13,8 @@
 #endif
 
 #include <time.h>
+#include <math.h>
+#include <pthread.h>
 #include <glad/glad.h>
 #include <glad/glad_egl.h>
 
@@ -26,11 +28,35 @@
 #include "shader.h"
 #include "texture.h"
 #include "mesh.h"
+#include "annotation.h"
+#include "pose.h"
+#include "imageset.h"
+#include "manifest.h"
+#include "rng.h"
+#include "checkpoint.h"
+#include "framebuffer.h"
+#include "composite.h"
+#include "spritecache.h"
+#include "glstate.h"
+#include "filter.h"
+#include "fileio.h"
 
 #include <cglm/cglm.h>
 
 #define PATHBUF_SIZE 512
 
+// MAX_INSTANCES of the LAYERED vert.glsl variant
+#define LAYERS_MAX 32
+
+// memory for backgrounds baked for compositing
+#define BAKED_BYTES ((size_t)256 << 20)
+
+enum {
+    OUTPUT_RGB,
+    OUTPUT_MASK,
+    OUTPUT_DEPTH,
+};
+
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
 # define realpath_(path, buffer)   \
     char **lppPart = {NULL};       \
@@ -43,12 +69,27 @@
 #endif
 
 
+// backgrounds as the quad pass draws them, read back for compositing
+struct baked_cache {
+    uint8_t **data;     // per background, NULL when not resident
+    uint64_t *used;     // per background, tick of its last use
+    int      *resident; // background held by each buffer
+    int       num, max;
+    uint64_t  tick;
+};
+
 struct renderer {
     mesh scene;
     mesh background_quad;
     shader s;
     shader bg;
+
+    // per-draw model matrices and culled draw commands
+    stream_buffer stream;
+    uint64_t surface_draws, surfaces_culled;
     camera cam;
+
+    framebuffer target;
 };
 
 struct application {
@@ -57,6 +98,7 @@ struct application {
     char background_images_path[PATHBUF_SIZE];
     char model_path[PATHBUF_SIZE];
     char frames_path[PATHBUF_SIZE];
+    char frames_fullpath[PATHBUF_SIZE];
     char annotations_path[PATHBUF_SIZE];
     char imagesets_path[PATHBUF_SIZE];
     char working_dir[PATHBUF_SIZE];
@@ -66,12 +108,52 @@ struct application {
     int ys, ye; 
 
     int thermal;
+    int output;
+    int unlit; // rgb output without lighting
+    int compact_vertices;
+    float lod_pixels; // screen space error a level of detail may add
+    int pose_labels;
+
+    int relabel;
+    int threads;
+    char pose_manifest_path[PATHBUF_SIZE];
+
+    imageset_config split;
+    frame_filter filter;
 
     int bg_count; 
-    texture *backgrounds;
+    texture *backgrounds; // w x h layers, bg_layers to an array
+    int bg_layers;
+    char **bg_paths;
+
+    uint64_t seed;
+    int manifest_format;
+    manifest manifest;
+
+    int resume;
+    int checkpoint_interval;
 
     GLFWwindow *wnd;
 
+    int headless;
+    int samples;
+
+    int batch;
+    int atlas_cols, atlas_rows;
+    int layers;
+    uint8_t *readback;
+
+    // frames per rendered pose, each on its own background
+    int composites;
+    struct baked_cache baked;
+    uint8_t *composite;
+
+    char sprite_cache_path[PATHBUF_SIZE];
+    char program_cache_path[PATHBUF_SIZE];
+    sprite_cache sprites;
+    uint8_t *sprite;
+    int scene_loaded;
+
     struct renderer rend;
 };
 
@@ -94,12 +176,9 @@ int is_image(const char *filename)
 }
 
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
-mrerror load_background_textures(const char *dir, int *count, texture **textures) {
-    char pathbuf[MAX_PATH];
-    mrerror err;
-
+static mrerror list_images(const char *dir, int *count, char ***paths) {
     *count = 0;
-    *textures = NULL;
+    *paths = NULL;
 
     WIN32_FIND_DATAA findData;
     HANDLE hFind = FindFirstFile(dir, &findData);
@@ -109,18 +188,8 @@ mrerror load_background_textures(const char *dir, int *count, texture **textures
 
     do {
         if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && is_image(findData.cFileName)) {
-
-            *textures = (texture *)realloc(*textures, (*count + 1) * sizeof(texture));
-
-            //realpath_(pathbuf, pathbuf);
-            //puts(pathbuf);
-
-            err = texture_find(&((*textures)[*count]), dir);
-            if (err.err) {
-                free(*textures);
-                FindClose(hFind);
-                return err;
-            }
+            *paths = (char **)realloc(*paths, (*count + 1) * sizeof(char *));
+            (*paths)[*count] = _strdup(findData.cFileName);
             (*count)++;
         }
     } while (FindNextFile(hFind, &findData) != 0);
@@ -129,13 +198,12 @@ mrerror load_background_textures(const char *dir, int *count, texture **textures
     return nilerr();
 }
 #else
-mrerror load_background_textures(const char *dir, int *count, texture **textures)
+static mrerror list_images(const char *dir, int *count, char ***paths)
 {
     char pathbuf[128];
-    mrerror err;
 
     *count = 0;
-    *textures = NULL;
+    *paths = NULL;
 
     DIR *dirp = opendir(dir);
     if (dirp == NULL) {
@@ -146,15 +214,8 @@ mrerror load_background_textures(const char *dir, int *count, texture **textures
     while ((entry = readdir(dirp)) != NULL) {
         if (entry->d_type == DT_REG && is_image(entry->d_name)) {
             snprintf(pathbuf, 128, "%s/%s", dir, entry->d_name);
-
-            *textures = (texture *)realloc(*textures, (*count + 1) * sizeof(texture));
-
-            err = texture_find(&((*textures)[*count]), pathbuf);
-            if (err.err) {
-                free(*textures);
-                closedir(dirp);
-                return err;
-            }
+            *paths = (char **)realloc(*paths, (*count + 1) * sizeof(char *));
+            (*paths)[*count] = strdup(pathbuf);
             (*count)++;
         }
     }
@@ -165,6 +226,42 @@ mrerror load_background_textures(const char *dir, int *count, texture **textures
 }
 #endif
 
+// backgrounds are only ever drawn full frame, so they are scaled to the
+// frame size once and share texture arrays, as few as the layer limit allows.
+// Background i is layer i % layers of array i / layers.
+mrerror load_background_textures(const char *dir, int w, int h, int *count, texture **arrays, int *layers, char ***paths)
+{
+    mrerror err;
+
+    err = list_images(dir, count, paths);
+    if (err.err) {
+        return err;
+    }
+    if (*count == 0) {
+        return mrerror_new("no background images");
+    }
+
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, layers);
+
+    int array_num = (*count + *layers - 1) / *layers;
+    *arrays = calloc(array_num, sizeof(texture));
+    if (!*arrays) {
+        return mrerror_new("malloc error");
+    }
+
+    for (int a = 0; a < array_num; a++) {
+        int first = a * *layers;
+        int num = *count - first < *layers ? *count - first : *layers;
+
+        err = texture_new_array_sized(&(*arrays)[a], (const char *const *)*paths + first, num, w, h);
+        if (err.err) {
+            return err;
+        }
+    }
+
+    return nilerr();
+}
+
 mrerror initGLFW(struct application *app)
 {
     glfwInit();
@@ -185,151 +282,839 @@ mrerror initGLFW(struct application *app)
     return nilerr();
 }
 
+#ifdef MR_EGL
+// not in the glad egl loader
+#define EGL_PLATFORM_DEVICE_EXT       0x313F
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+typedef EGLBoolean (*PFNEGLQUERYDEVICESEXTPROC)(EGLint max_devices, EGLDeviceEXT *devices, EGLint *num_devices);
+
+static EGLDisplay egl_display()
+{
+    EGLDeviceEXT devices[8];
+    EGLint devices_num = 0;
+    EGLDisplay dpy;
+
+    PFNEGLQUERYDEVICESEXTPROC query_devices =
+        (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+
+    if (query_devices && query_devices(8, devices, &devices_num)) {
+        for (int i = 0; i < devices_num; i++) {
+            dpy = eglGetPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[i], NULL);
+            if (dpy != EGL_NO_DISPLAY && eglInitialize(dpy, NULL, NULL)) {
+                return dpy;
+            }
+        }
+    }
+
+    dpy = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (dpy != EGL_NO_DISPLAY && eglInitialize(dpy, NULL, NULL)) {
+        return dpy;
+    }
+
+    return EGL_NO_DISPLAY;
+}
+
+// no window system at all, everything is drawn into app->rend.target
+mrerror initEGL(struct application *app)
+{
+    EGLConfig config;
+    EGLint config_num;
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, 0,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    EGLDisplay dpy = egl_display();
+    if (dpy == EGL_NO_DISPLAY) {
+        return mrerror_new("no EGL device or surfaceless display");
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        return mrerror_new("eglBindAPI");
+    }
+
+    if (!eglChooseConfig(dpy, config_attribs, &config, 1, &config_num) || config_num < 1) {
+        return mrerror_new("eglChooseConfig");
+    }
+
+    EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, context_attribs);
+    if (ctx == EGL_NO_CONTEXT) {
+        return mrerror_new("eglCreateContext");
+    }
+
+    if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        return mrerror_new("eglMakeCurrent");
+    }
+
+    app->wnd = NULL;
+    return nilerr();
+}
+#endif
+
+static int gl_has_extension(const char *name)
+{
+    int count;
+
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++) {
+        if (!strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// objects are rendered alone and put over backgrounds on the CPU
+static int compositing(const struct application *app)
+{
+    return app->composites > 1 || app->sprite_cache_path[0];
+}
+
+// feature toggles of the vert.glsl and frag.glsl variant this run needs
+static void scene_defines(const struct application *app, char *defines, size_t size)
+{
+    snprintf(defines, size, "%s%s%s%s%s%s%s",
+             app->layers ? "LAYERED " : "",
+             app->compact_vertices ? "COMPACT_VERTICES " : "",
+             app->thermal ? "THERMAL " : "",
+             !app->thermal && app->texture_path[0] ? "TEXTURED " : "",
+             app->unlit ? "UNLIT " : "",
+             app->output == OUTPUT_MASK ? "MASK_OUTPUT " : "",
+             app->output == OUTPUT_DEPTH ? "DEPTH_OUTPUT " : "");
+}
+
 void debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam) {
     fprintf(stderr, "OpenGL Debug Message: %s\n", message);
 }
 
 mrerror initGL(struct application *app)
 {   
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    GLADloadproc loader = (GLADloadproc)glfwGetProcAddress;
+#ifdef MR_EGL
+    if (app->headless) {
+        loader = (GLADloadproc)eglGetProcAddress;
+    }
+#endif
+
+    if (!gladLoadGLLoader(loader)) {
         return mrerror_new("Can't init GL");
     }
 
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
 
+    // sample count is set by the render target, see -A
     glEnable(GL_MULTISAMPLE);  
     glEnable(GL_CULL_FACE); 
     
     glEnable(GL_DEBUG_OUTPUT);
     glDebugMessageCallback((GLDEBUGPROC)debug_callback, 0);
 
-    glClearColor(0.5, 0.1, 0.4, 1.0);
+    mrerror err;
 
-    glViewport(0, 0, app->w, app->h);
-    app->rend.scene = mesh_load_obj(app->model_path, app->texture_path);
-    app->rend.scene.rotation[0] = glm_rad(90.0f); 
-    shader_new(&app->rend.s, "assets/vert.glsl", app->thermal ? "assets/thermal_frag.glsl" : "assets/frag.glsl");
+    // compiles run while the rest of the setup and loading happens,
+    // finished in initShaders
+    if (gl_has_extension("GL_KHR_parallel_shader_compile")) {
+        shader_set_parallel(loader("glMaxShaderCompilerThreadsKHR"));
+    }
+    else if (gl_has_extension("GL_ARB_parallel_shader_compile")) {
+        shader_set_parallel(loader("glMaxShaderCompilerThreadsARB"));
+    }
 
-    app->rend.background_quad = mesh_new_quad();
-    shader_new(&app->rend.bg, "assets/bg_vert.glsl", app->thermal ? "assets/bg_thermal_frag.glsl" : "assets/bg_frag.glsl");
+    char defines[128];
 
-    app->rend.cam = (camera){
-        {0, app->distance, 0},
-        {0, 0, 0},
-        45.0
-    };
+    scene_defines(app, defines, sizeof(defines));
+    err = shader_begin(&app->rend.s, "assets/vert.glsl", "assets/frag.glsl", defines);
+    if (err.err) {
+        return err;
+    }
+
+    snprintf(defines, sizeof(defines), "%s%s", app->layers ? "LAYERED " : "", app->thermal ? "THERMAL " : "");
+    err = shader_begin(&app->rend.bg, "assets/bg_vert.glsl", "assets/bg_frag.glsl", defines);
+    if (err.err) {
+        return err;
+    }
+
+    // composites need coverage in alpha and premultiplied color
+    if (compositing(app)) {
+        glClearColor(0.0, 0.0, 0.0, 0.0);
+    }
+    else if (app->output != OUTPUT_RGB) {
+        glClearColor(0.0, 0.0, 0.0, 1.0);
+    }
+    else {
+        glClearColor(0.5, 0.1, 0.4, 1.0);
+    }
+
+    if (app->layers) {
+        if (!gl_has_extension("GL_ARB_shader_viewport_layer_array")) {
+            return mrerror_new("layered rendering needs GL_ARB_shader_viewport_layer_array");
+        }
+
+        app->batch = app->layers;
+        err = framebuffer_new_layered(&app->rend.target, app->w, app->h, app->samples, app->layers);
+    }
+    else {
+        // batches are laid out as a grid of w x h tiles in one target
+        int max_size[2];
+        glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_size);
+
+        app->atlas_cols = (int)ceil(sqrt(app->batch));
+        while (app->atlas_cols > 1 && app->atlas_cols * app->w > max_size[0]) {
+            app->atlas_cols--;
+        }
+        app->atlas_rows = (app->batch + app->atlas_cols - 1) / app->atlas_cols;
+        while (app->atlas_rows > 1 && app->atlas_rows * app->h > max_size[1]) {
+            app->atlas_rows--;
+        }
+        app->batch = app->batch < app->atlas_cols * app->atlas_rows ? app->batch : app->atlas_cols * app->atlas_rows;
+
+        err = framebuffer_new(&app->rend.target, app->atlas_cols * app->w, app->atlas_rows * app->h, app->samples);
+    }
+    if (err.err) {
+        return err;
+    }
+    framebuffer_bind(&app->rend.target);
+
+    app->readback = malloc((size_t)app->rend.target.w * app->rend.target.h * 4 * (app->layers ? app->layers : 1));
+    if (!app->readback) {
+        return mrerror_new("malloc error");
+    }
+
+    if (compositing(app)) {
+        app->composite = malloc((size_t)app->w * app->h * 3);
+        if (!app->composite) {
+            return mrerror_new("malloc error");
+        }
+    }
+
+    glViewport(0, 0, app->w, app->h);
+    app->rend.background_quad = mesh_new_quad();
 
     return nilerr();
 }
 
-#define SPOS(w, x) ((w/2.0)*(1 + x))
+// waits for the programs submitted in initGL
+mrerror initShaders(struct application *app)
+{
+    mrerror err;
+
+    err = shader_finish(&app->rend.s);
+    if (err.err) {
+        return err;
+    }
+    err = shader_finish(&app->rend.bg);
+    if (err.err) {
+        return err;
+    }
+
+    return nilerr();
+}
 
 const char annotation_head[] = "<annotation><folder>%s</folder><filename>%s</filename><path>%s</path><source><database>Unknown</database></source><size><width>%d</width><height>%d</height><depth>3</depth></size><segmented>0</segmented>";
-const char annotation_object[] = "<object><name>%s</name><pose>Unspecified</pose><truncated>0</truncated><difficult>0</difficult><bndbox><xmin>%d</xmin><ymin>%d</ymin><xmax>%d</xmax><ymax>%d</ymax></bndbox></object>";
+const char annotation_object[] = "<object><name>%s</name><pose>Unspecified</pose><truncated>0</truncated><difficult>0</difficult><bndbox><xmin>%d</xmin><ymin>%d</ymin><xmax>%d</xmax><ymax>%d</ymax></bndbox>";
+const char annotation_object_tail[] = "</object>";
 const char annotation_tail[] = "</annotation>";
 
-void export_annotation(const char *filename, const char *imagefile, struct application app, mesh m, mat4 model, mat4 view, mat4 proj)
+static void export_pose(FILE *f, const annotation *a)
 {
-    mat4 mvp;
-    float min[2], max[2], temp;
+    fprintf(f, "<pose6d><rotation>");
+    for (int i = 0; i < 9; i++) {
+        // row-major, R[row][col]
+        fprintf(f, i ? " %.6g" : "%.6g", a->rotation[i%3][i/3]);
+    }
+    fprintf(f, "</rotation><translation>%.6g %.6g %.6g</translation>",
+            a->translation[0], a->translation[1], a->translation[2]);
+    fprintf(f, "<intrinsics>%.6g %.6g %.6g %.6g</intrinsics><keypoints>",
+            a->intrinsics[0], a->intrinsics[1], a->intrinsics[2], a->intrinsics[3]);
+    for (int i = 0; i < ANNOTATION_KEYPOINTS; i++) {
+        fprintf(f, i ? " %.2f %.2f" : "%.2f %.2f", a->keypoints[i][0], a->keypoints[i][1]);
+    }
+    fprintf(f, "</keypoints></pose6d>");
+}
 
-    min[0] = min[1] = FLT_MAX;
-    max[0] = max[1] = -FLT_MAX;
+mrerror export_annotation(const struct application *app, uint32_t id, const annotation *a)
+{
+    char filename[PATHBUF_SIZE];
+    char tmpfile[PATHBUF_SIZE + 4];
+    char imagefile[32];
+    char fullpath[PATHBUF_SIZE*2];
 
-    glm_mat4_mul(proj, view, mvp);
-    glm_mat4_mul(mvp, model, mvp);
+    snprintf(filename, PATHBUF_SIZE, "%s/%u.xml", app->annotations_path, id);
+    snprintf(tmpfile, PATHBUF_SIZE + 4, "%s.tmp", filename);
+    snprintf(imagefile, 32, "%u.png", id);
+    snprintf(fullpath, PATHBUF_SIZE*2, "%s/%s", app->frames_fullpath, imagefile);
 
-    for (int i = 0; i < 8; i++) {
-        vec4 vert, result;
-        vec2 screen;
+    FILE *f = fopen(tmpfile, "w");
+    if (f == NULL) {
+        return mrerror_new("can't write annotation");
+    }
+
+    fprintf(f, annotation_head, strrchr(app->frames_path, '/') + 1, imagefile, fullpath, app->w, app->h);
+    fprintf(f, annotation_object, app->name, a->xmin, a->ymin, a->xmax, a->ymax);
+    if (app->pose_labels) {
+        export_pose(f, a);
+    }
+    fprintf(f, annotation_object_tail);
+    fprintf(f, annotation_tail);
+    fclose(f);
 
-        vert[0] = m.bound_box[i*4];
-        vert[1] = m.bound_box[i*4+1];
-        vert[2] = m.bound_box[i*4+2];
-        vert[3] = m.bound_box[i*4+3];
+    if (!fileio_replace(tmpfile, filename)) {
+        remove(tmpfile);
+        return mrerror_new("can't write annotation");
+    }
 
+    return nilerr();
+}
 
-        glm_mat4_mulv(mvp, vert, result);
-        screen[0] = result[0] / (result[3]*1.06);
-        screen[1] = result[1] / (result[3]*1.06);
+mrerror export_png(const char *filename, const uint8_t *data, int width, int height, int stride)
+{
+    char tmpfile[PATHBUF_SIZE + 4];
 
-        min[0] = min[0] < screen[0] ? min[0] : screen[0];
-        min[1] = min[1] < screen[1] ? min[1] : screen[1];
-        max[0] = max[0] > screen[0] ? max[0] : screen[0];
-        max[1] = max[1] > screen[1] ? max[1] : screen[1];
+    // a frame only appears under its final name once it is complete
+    snprintf(tmpfile, PATHBUF_SIZE + 4, "%s.tmp", filename);
+    if (!stbi_write_png(tmpfile, width, height, 3, data, stride)) {
+        return mrerror_new("stbi_write_png");
+    }
+    if (!fileio_replace(tmpfile, filename)) {
+        remove(tmpfile);
+        return mrerror_new("can't write frame");
     }
 
-    FILE *f = fopen(filename, "w");
-    if (f == NULL) {
-        return;
-    }    
+    return nilerr();
+}
 
-    int xmin, xmax, ymin, ymax;
-    xmin = (int)(SPOS(app.w, min[0]));
-    xmax = (int)(SPOS(app.w, max[0]));
-    ymin = (int)(SPOS(app.h, min[1]));
-    ymax = (int)(SPOS(app.h, max[1]));
+struct frame {
+    pose p;
+    int index; // in the pose list
+    manifest_record rec;
+    annotation a;
+};
 
-    char fullpath[PATHBUF_SIZE];
-    realpath_(imagefile, fullpath);
+// composite k of a pose, the ids of a pose stay contiguous
+static uint32_t frame_id(const struct application *app, uint32_t pose_id, int k)
+{
+    return (pose_id - 1) * app->composites + k + 1;
+}
 
-    fprintf(f, annotation_head, strrchr(app.frames_path, '/') + 1, strrchr(imagefile, '/') + 1, fullpath, app.w, app.h);
-    fprintf(f, annotation_object, app.name, xmin, ymin, xmax, ymax);
-    fprintf(f, annotation_tail);
-    fclose(f);
+// per-frame stream so any frame's background can be reproduced alone
+static manifest_record frame_record(const struct application *app, const pose *p, uint32_t id)
+{
+    manifest_record rec = {
+        .id = id,
+        .yaw = p->yaw,
+        .pitch = p->pitch,
+        .seed = app->seed ^ (id * 0x9e3779b97f4a7c15ull),
+    };
+    rng r;
+
+    rng_seed(&r, rec.seed);
+    rec.background = rng_range(&r, app->bg_count);
+
+    return rec;
 }
 
-mrerror export_png(char *filename)
+// one entry per output frame, composites of a pose share its angles
+static pose *frame_poses(const struct application *app, const pose *poses, int count)
 {
-    uint32_t viewport[4];
-	glGetIntegerv(GL_VIEWPORT, viewport);
+    pose *frames = malloc((size_t)count * app->composites * sizeof(pose));
+    if (!frames) {
+        return NULL;
+    }
 
-	int x = viewport[0];
-	int y = viewport[1];
-	int width = viewport[2];
-	int height = viewport[3];
+    for (int i = 0; i < count; i++) {
+        for (int k = 0; k < app->composites; k++) {
+            pose *f = &frames[(size_t)i * app->composites + k];
 
-    char *data = (char*) calloc(1, (size_t) (width * height * 3));
+            *f = poses[i];
+            f->id = frame_id(app, poses[i].id, k);
+        }
+    }
+    return frames;
+}
 
-	if (!data)
-		return mrerror_new("malloc error");
+// needs the programs, and the scene for the culled command lists: a batch
+// worth of Models ranges, background quads and command lists per slot, with
+// room for alignment. Created without the scene for backgrounds baked before
+// it is loaded, and grown once it is.
+static mrerror init_stream(struct application *app)
+{
+    size_t surfaces = app->scene_loaded ? app->rend.scene.surf_num : 0;
+    size_t commands = surfaces * sizeof(draw_command) + 256;
+    int draws = app->layers ? 1 : app->batch;
+    size_t size = (size_t)app->batch * (app->rend.s.models_size + app->rend.bg.quads_size + 512) + draws * commands;
+
+    if (app->rend.stream.buffer) {
+        if (app->rend.stream.slot_size >= size) {
+            return nilerr();
+        }
+        // draws already issued keep the old buffer alive until they are done
+        stream_free(&app->rend.stream);
+    }
 
-	glPixelStorei(GL_PACK_ALIGNMENT, 1);
-	glReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, data);
+    return stream_new(&app->rend.stream, size);
+}
 
-    stbi_write_png(filename, width, height, 3, data, 0);
+// quad i shows background backgrounds[i], on layer i when layered. The
+// indices go through the stream next to the Models entries, with one
+// instanced draw per background array the quads use.
+static void render_backgrounds(struct application *app, const int32_t *backgrounds, int n)
+{
+    const shader *bg = &app->rend.bg;
 
-    free(data);
+    for (int a = 0; a * app->bg_layers < app->bg_count; a++) {
+        int count = 0;
 
-    return nilerr();
+        for (int i = 0; i < n; i++) {
+            count += backgrounds[i] / app->bg_layers == a;
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        size_t size = (size_t)count * sizeof(int32_t[4]);
+        size_t offset;
+
+        if (bg->quads_size > (int)size) {
+            size = bg->quads_size;
+        }
+
+        int32_t (*quads)[4] = stream_alloc(&app->rend.stream, size, &offset);
+        if (!quads) {
+            return;
+        }
+
+        for (int i = 0, k = 0; i < n; i++) {
+            if (backgrounds[i] / app->bg_layers == a) {
+                quads[k][0] = backgrounds[i] % app->bg_layers;
+                quads[k][1] = i;
+                k++;
+            }
+        }
+
+        glBindBufferRange(GL_UNIFORM_BUFFER, SHADER_QUADS_BINDING, app->rend.stream.buffer, offset, size);
+        app->rend.background_quad.texture = app->backgrounds[a];
+        mesh_render_quad(&app->rend.background_quad, bg, count);
+    }
 }
 
-void render_frame(struct application app)
+// the background as the quad pass draws it at w x h, read back when a
+// composite needs it; up to BAKED_BYTES of them stay resident and the least
+// recently used one makes room
+static const uint8_t *baked_background(struct application *app, int index)
 {
-    static int frame_count = 0;
-    frame_count++;
+    struct baked_cache *c = &app->baked;
+    framebuffer *fb = &app->rend.target;
+    int32_t background = index;
+    uint8_t *layer = NULL;
+    uint8_t *data;
+
+    if (!c->data) {
+        size_t fit = BAKED_BYTES / ((size_t)app->w * app->h * 3);
+
+        c->max = fit < 1 ? 1 : fit > (size_t)app->bg_count ? app->bg_count : (int)fit;
+        c->data = calloc(app->bg_count, sizeof(uint8_t *));
+        c->used = calloc(app->bg_count, sizeof(uint64_t));
+        c->resident = calloc(c->max, sizeof(int));
+        if (!c->data || !c->used || !c->resident) {
+            free(c->data);
+            free(c->used);
+            free(c->resident);
+            memset(c, 0, sizeof(struct baked_cache));
+            return NULL;
+        }
+    }
 
-    char image_filename[PATHBUF_SIZE];
-    char annotation_filename[PATHBUF_SIZE];
-    mat4 model, view, proj;
-    
+    c->used[index] = ++c->tick;
+    if (c->data[index]) {
+        return c->data[index];
+    }
+
+    // cached poses can get here before any batch created the stream
+    mrerror err = init_stream(app);
+    if (err.err) {
+        printf("%s\n", err.msg);
+        return NULL;
+    }
+
+    if (app->layers) {
+        layer = malloc((size_t)app->w * app->h * 4);
+        if (!layer) {
+            return NULL;
+        }
+    }
+
+    if (c->num < c->max) {
+        data = malloc((size_t)app->w * app->h * 3);
+        if (!data) {
+            free(layer);
+            return NULL;
+        }
+        c->resident[c->num++] = index;
+    }
+    else {
+        int lru = 0;
+
+        for (int i = 1; i < c->num; i++) {
+            if (c->used[c->resident[i]] < c->used[c->resident[lru]]) {
+                lru = i;
+            }
+        }
+
+        // its buffer is reused for this one
+        data = c->data[c->resident[lru]];
+        c->data[c->resident[lru]] = NULL;
+        c->resident[lru] = index;
+    }
+
+    framebuffer_bind(fb);
+    glViewport(0, 0, app->w, app->h);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    camera_update(app.w, app.h, app.rend.s, app.rend.cam, view, proj);
+    render_backgrounds(app, &background, 1);
+
+    framebuffer_resolve(fb);
+    if (app->layers) {
+        framebuffer_read_layers(fb, 1, 4, layer);
+        for (size_t i = 0; i < (size_t)app->w * app->h; i++) {
+            memcpy(data + i*3, layer + i*4, 3);
+        }
+        free(layer);
+    }
+    else {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, app->w, app->h, GL_RGB, GL_UNSIGNED_BYTE, data);
+    }
+
+    c->data[index] = data;
+    return data;
+}
+
+// surfaces outside every frustum of the draw are left out of it
+static void cull_scene(struct application *app, mat4 *mvps, int n)
+{
+    mesh *scene = &app->rend.scene;
+
+    // the coarsest level that stays within lod_pixels at this distance
+    if (scene->lod_num > 1) {
+        float radius = 0;
+
+        // the bounds spin around the origin, sweeping this sphere
+        for (int i = 0; i < 8; i++) {
+            float r = glm_vec3_norm(&scene->bound_box[i*4]);
+            radius = r > radius ? r : radius;
+        }
+        mesh_select_lod(scene, app->lod_pixels * camera_pixel_size(app->w, app->h, app->rend.cam, radius));
+    }
+
+    uint32_t kept = mesh_cull(scene, &app->rend.stream, mvps, n);
+
+    app->rend.surface_draws += scene->surf_num;
+    app->rend.surfaces_culled += scene->surf_num - kept;
+}
+
+// draws one pose into its atlas tile
+void render_frame(struct application *app, struct frame *f, int tile)
+{
+    mat4 model, view, proj;
+
+    glViewport((tile % app->atlas_cols) * app->w, (tile / app->atlas_cols) * app->h, app->w, app->h);
+
+    app->rend.scene.rotation[0] = glm_rad(f->p.yaw);
+    app->rend.scene.rotation[1] = glm_rad(f->p.pitch);
+
+    camera_update(app->w, app->h, app->rend.cam, view, proj);
 
     glm_mat4_identity(model);
-    mesh_render(app.rend.scene, app.rend.s, model);
+    camera_transform_mesh(&app->rend.stream, &app->rend.s, &app->rend.scene, model);
 
-    app.rend.background_quad.texture = app.backgrounds[rand()%app.bg_count];
-    mesh_render_quad(app.rend.background_quad, app.rend.bg);
+    mat4 mvp;
+    glm_mat4_mulN((mat4 *[]){&proj, &view, &model}, 3, mvp);
+    cull_scene(app, &mvp, 1);
+    mesh_render(&app->rend.scene, &app->rend.s);
+
+    if (!compositing(app)) {
+        f->rec = frame_record(app, &f->p, f->p.id);
+    }
+    if (!compositing(app) && app->output == OUTPUT_RGB) {
+        render_backgrounds(app, &f->rec.background, 1);
+    }
+
+    annotation_compute(&f->a, app->rend.scene.bound_box, app->w, app->h, model, view, proj);
+}
+
+// deferred until a pose misses the sprite cache
+static void load_scene(struct application *app)
+{
+    app->rend.scene = mesh_load_obj(app->model_path, app->texture_path,
+                                    (app->compact_vertices ? MESH_LOAD_COMPACT : 0) |
+                                    (app->lod_pixels > 0 ? MESH_LOAD_LODS : 0));
+    app->rend.scene.rotation[0] = glm_rad(90.0f);
+    app->scene_loaded = 1;
+}
+
+
+// all poses of the batch in one instanced draw per surface, pose i goes to layer i
+void render_layers(struct application *app, struct frame *frames, int n)
+{
+    mat4 models[LAYERS_MAX], mvps[LAYERS_MAX], view, proj;
+
+    camera_update(app->w, app->h, app->rend.cam, view, proj);
+
+    for (int i = 0; i < n; i++) {
+        vec3 rotation = {glm_rad(frames[i].p.yaw), glm_rad(frames[i].p.pitch), 0};
+
+        glm_mat4_identity(models[i]);
+        camera_model(rotation, models[i]);
+
+        annotation_compute(&frames[i].a, app->rend.scene.bound_box, app->w, app->h, models[i], view, proj);
+        glm_mat4_mulN((mat4 *[]){&proj, &view, &models[i]}, 3, mvps[i]);
+    }
+
+    camera_transform_instances(&app->rend.stream, &app->rend.s, models, n);
+    cull_scene(app, mvps, n);
+    mesh_render_instanced(&app->rend.scene, &app->rend.s, n);
+
+    if (compositing(app)) {
+        return;
+    }
+
+    int32_t backgrounds[LAYERS_MAX];
+
+    for (int i = 0; i < n; i++) {
+        frames[i].rec = frame_record(app, &frames[i].p, frames[i].p.id);
+        backgrounds[i] = frames[i].rec.background;
+    }
+
+    // every layer's background in one draw
+    if (app->output == OUTPUT_RGB) {
+        render_backgrounds(app, backgrounds, n);
+    }
+}
+
+// one geometry pass, composites frames sharing its labels
+static void export_composites(struct application *app, const struct frame *f, const uint8_t *rgba, int stride)
+{
+    char image_filename[PATHBUF_SIZE];
+
+    for (int k = 0; k < app->composites; k++) {
+        manifest_record rec = frame_record(app, &f->p, frame_id(app, f->p.id, k));
+        const uint8_t *bg = baked_background(app, rec.background);
+
+        if (!bg) {
+            printf("can't bake background %d\n", rec.background);
+            continue;
+        }
+
+        composite_over(app->composite, rgba, stride, bg, app->w, app->h);
+
+        snprintf(image_filename, PATHBUF_SIZE, "%s/%u.png", app->frames_path, rec.id);
+        mrerror err = export_png(image_filename, app->composite, app->w, app->h, app->w * 3);
+        if (!err.err) {
+            err = export_annotation(app, rec.id, &f->a);
+        }
+        if (err.err) {
+            printf("%s\n", err.msg);
+        }
+        manifest_write(&app->manifest, &rec);
+    }
+}
+
+// one clear, resolve and readback for the whole batch, then split into frames
+void render_batch(struct application *app, struct frame *frames, int n)
+{
+    char image_filename[PATHBUF_SIZE];
+    framebuffer *fb = &app->rend.target;
+    int stride;
+
+    // a background baked for a cache hit leaves the resolve target bound
+    framebuffer_bind(fb);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (app->layers) {
+        render_layers(app, frames, n);
+    }
+    else {
+        for (int i = 0; i < n; i++) {
+            render_frame(app, &frames[i], i);
+        }
+    }
+    stream_next(&app->rend.stream);
 
     // saving result
 
-    snprintf(image_filename, 64, "%s/%d.png", app.frames_path, frame_count);
-    export_png(image_filename);
-    snprintf(annotation_filename, 64, "%s/%d.xml", app.annotations_path, frame_count);
-    export_annotation(annotation_filename, image_filename, app, app.rend.scene, model, view, proj);
+    int channels = compositing(app) ? 4 : 3;
+
+    framebuffer_resolve(fb);
+    if (app->layers) {
+        framebuffer_read_layers(fb, n, channels, app->readback);
+        stride = app->w * channels;
+    }
+    else {
+        int rows = (n + app->atlas_cols - 1) / app->atlas_cols;
+
+        stride = fb->w * channels;
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, fb->w, rows * app->h, channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, app->readback);
+    }
+
+    for (int i = 0; i < n; i++) {
+        const uint8_t *tile = app->layers ?
+            app->readback + (size_t)i * app->h * stride :
+            app->readback + (size_t)(i / app->atlas_cols) * app->h * stride + (i % app->atlas_cols) * app->w * channels;
+
+        if (!compositing(app)) {
+            snprintf(image_filename, PATHBUF_SIZE, "%s/%u.png", app->frames_path, frames[i].p.id);
+            mrerror err = export_png(image_filename, tile, app->w, app->h, stride);
+            if (!err.err) {
+                err = export_annotation(app, frames[i].p.id, &frames[i].a);
+            }
+            if (err.err) {
+                printf("%s\n", err.msg);
+            }
+            manifest_write(&app->manifest, &frames[i].rec);
+            continue;
+        }
+
+        if (app->sprite_cache_path[0]) {
+            mrerror err = sprite_cache_store(&app->sprites, &frames[i].p, &frames[i].a, tile, stride);
+            if (err.err) {
+                printf("%s\n", err.msg);
+            }
+        }
+
+        export_composites(app, &frames[i], tile, stride);
+    }
+}
+
+struct relabel_job {
+    const struct application *app;
+    const pose *poses;
+    int count;
+};
+
+static void *relabel_worker(void *arg)
+{
+    struct relabel_job *job = arg;
+    const struct application *app = job->app;
+    mat4 model, view, proj;
+    annotation a;
+
+    camera_matrices(app->w, app->h, app->rend.cam, view, proj);
+
+    for (int i = 0; i < job->count; i++) {
+        vec3 rotation = {glm_rad(job->poses[i].yaw), glm_rad(job->poses[i].pitch), 0};
+
+        glm_mat4_identity(model);
+        camera_model(rotation, model);
+
+        annotation_compute(&a, app->rend.scene.bound_box, app->w, app->h, model, view, proj);
+        mrerror err = export_annotation(app, job->poses[i].id, &a);
+        if (err.err) {
+            printf("%s\n", err.msg);
+        }
+    }
+
+    return NULL;
+}
+
+// drops the poses the filter rejects, judged from the bounds alone, ids are kept
+static int filter_poses(const struct application *app, const float *bound_box, pose *poses, int count)
+{
+    mat4 model, view, proj;
+    annotation a;
+    int kept = 0;
+
+    camera_matrices(app->w, app->h, app->rend.cam, view, proj);
+
+    for (int i = 0; i < count; i++) {
+        vec3 rotation = {glm_rad(poses[i].yaw), glm_rad(poses[i].pitch), 0};
+
+        glm_mat4_identity(model);
+        camera_model(rotation, model);
+
+        annotation_compute(&a, bound_box, app->w, app->h, model, view, proj);
+        if (filter_accept(&app->filter, &a, app->w, app->h)) {
+            poses[kept++] = poses[i];
+        }
+    }
+
+    return kept;
+}
+
+// recomputes every label from the bounds alone, no window or GL context
+mrerror relabel_main(struct application *app)
+{
+    pose *poses;
+    int count;
+    mrerror err;
+
+    err = mesh_load_bounds(app->model_path, app->rend.scene.bound_box);
+    if (err.err) {
+        return err;
+    }
+
+    if (app->pose_manifest_path[0]) {
+        err = pose_manifest_read(app->pose_manifest_path, &poses, &count);
+        if (err.err) {
+            return err;
+        }
+    }
+    else {
+        count = pose_grid(app->ys, app->ye, app->ps, app->pe, &poses);
+
+        // the same poses app_main rendered
+        if (filter_enabled(&app->filter)) {
+            count = filter_poses(app, app->rend.scene.bound_box, poses, count);
+        }
+
+        // a frame manifest already lists every composite
+        if (app->composites > 1) {
+            pose *frames = frame_poses(app, poses, count);
+
+            free(poses);
+            if (!frames) {
+                return mrerror_new("malloc error");
+            }
+            poses = frames;
+            count *= app->composites;
+        }
+    }
+
+    int threads = app->threads > 0 ? app->threads : 1;
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    struct relabel_job *jobs = calloc(threads, sizeof(struct relabel_job));
+
+    int chunk = (count + threads - 1) / threads;
+    for (int t = 0; t < threads; t++) {
+        int first = t*chunk < count ? t*chunk : count;
+
+        jobs[t].app = app;
+        jobs[t].poses = poses + first;
+        jobs[t].count = first + chunk < count ? chunk : count - first;
+
+        pthread_create(&tids[t], NULL, relabel_worker, &jobs[t]);
+    }
+
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+
+    printf("relabeled %d frames\n", count);
+
+    free(jobs);
+    free(tids);
+    free(poses);
+
+    return nilerr();
 }
 
 static void rmkdir(const char *dir) {
@@ -351,79 +1136,221 @@ static void rmkdir(const char *dir) {
     mkdir_p(tmp);
 }
 
+static void save_progress(struct application *app, checkpoint *ckpt)
+{
+    mrerror err;
+
+    // records reach the disk before the checkpoint that counts them
+    manifest_flush(&app->manifest);
+    ckpt->records = app->manifest.records;
+
+    err = checkpoint_save(ckpt);
+    if (err.err) {
+        printf("%s\n", err.msg);
+    }
+}
+
 void app_main(struct application app)
 {
     char filename[64];
-    
-    int frames_count = 1;
+    mrerror err;
+    checkpoint ckpt;
 
-    for (int x = app.ys/5; x <= app.ye/5; x++) {
-        for (int y = app.ps/5; y <= app.pe/5; y++) {
-            if (glfwWindowShouldClose(app.wnd))
-                return;
+    pose *poses;
+    int poses_count = pose_grid(app.ys, app.ye, app.ps, app.pe, &poses);
 
-            app.rend.scene.rotation[0] = glm_rad(x*5);
-            app.rend.scene.rotation[1] = glm_rad(y*5);
+    // rejected poses never reach the checkpoint, the manifest or the splits
+    if (filter_enabled(&app.filter)) {
+        float bounds[4*8];
+        int grid_count = poses_count;
 
-            frames_count++;
+        err = app.scene_loaded ? nilerr() : mesh_load_bounds(app.model_path, bounds);
+        if (err.err) {
+            printf("%s\n", err.msg);
+            free(poses);
+            return;
+        }
 
-            render_frame(app);
+        poses_count = filter_poses(&app, app.scene_loaded ? app.rend.scene.bound_box : bounds, poses, poses_count);
+        printf("filter: %d of %d poses rejected\n", grid_count - poses_count, grid_count);
+    }
 
-            glfwSwapBuffers(app.wnd);
-            glfwPollEvents();  
+    checkpoint_params params = {
+        .grid = {app.ys, app.ye, app.ps, app.pe},
+        .composites = app.composites,
+        .compositing = compositing(&app),
+        .filter = {app.filter.min_area, app.filter.max_truncation, app.filter.max_aspect},
+    };
+    err = checkpoint_open(&ckpt, app.working_dir, app.seed, &params, poses_count, app.resume);
+    if (err.err) {
+        printf("%s\n", err.msg);
+        free(poses);
+        return;
+    }
+
+    app.seed = ckpt.seed;
+    app.split.seed = ckpt.seed;
+    printf("seed %llu\n", (unsigned long long)app.seed);
+    if (app.resume) {
+        printf("resuming, %u of %d frames done\n", ckpt.done_num, poses_count);
+    }
+
+    err = manifest_open(&app.manifest, app.working_dir, app.manifest_format, app.resume, ckpt.records,
+                        app.frames_path, app.annotations_path,
+                        app.bg_paths, app.bg_count);
+    if (err.err) {
+        printf("%s\n", err.msg);
+        checkpoint_close(&ckpt);
+        free(poses);
+        return;
+    }
+
+    int sprite_hits = 0;
+    if (app.sprite_cache_path[0]) {
+        // everything that changes a sprite's pixels, see spritecache.h
+        const char *inputs[] = {
+            app.model_path, app.texture_path,
+            "assets/vert.glsl", "assets/frag.glsl",
+        };
+        int32_t params[] = {app.w, app.h, app.samples, app.distance, app.thermal, app.output, app.unlit, app.compact_vertices,
+                            (int32_t)(app.lod_pixels * 1000)};
+
+        err = sprite_cache_open(&app.sprites, app.sprite_cache_path, inputs, 4, params, sizeof(params), app.w, app.h);
+        app.sprite = malloc((size_t)app.w * app.h * 4);
+        if (!err.err && !app.sprite) {
+            err = mrerror_new("malloc error");
         }
+        if (err.err) {
+            printf("%s\n", err.msg);
+            manifest_close(&app.manifest);
+            checkpoint_close(&ckpt);
+            free(poses);
+            return;
+        }
+        rmkdir(app.sprites.dir);
     }
 
-    frames_count++;
+    struct frame *frames = calloc(app.batch, sizeof(struct frame));
+    int since_save = 0;
+    int p = 0;
+
+    while (p < poses_count) {
+        int n = 0;
 
-    unsigned char *picked = calloc(frames_count/8 + 1, 1); // bitset of size 100
-    int *nums = calloc(frames_count, sizeof(int));
+        for (; p < poses_count && n < app.batch; p++) {
+            if (checkpoint_done(&ckpt, p))
+                continue;
 
-    int i, j, rand_num;
+            frames[n].p = poses[p];
+            frames[n].index = p;
+
+            // cached poses go straight to compositing
+            if (app.sprite_cache_path[0] && sprite_cache_load(&app.sprites, &poses[p], &frames[n].a, app.sprite)) {
+                export_composites(&app, &frames[n], app.sprite, app.w * 4);
+                checkpoint_mark(&ckpt, p);
+                sprite_hits++;
+                since_save++;
+                continue;
+            }
+            n++;
+        }
+        if (n == 0) {
+            if (since_save >= app.checkpoint_interval) {
+                save_progress(&app, &ckpt);
+                since_save = 0;
+            }
+            continue;
+        }
 
-    srand(time(NULL)); // initialize the random seed
-    for (i = 0; i < frames_count/8 + 1; i++) {
-        picked[i] = 0;
+        if (!app.scene_loaded) {
+            load_scene(&app);
+        }
+        err = init_stream(&app);
+        if (err.err) {
+            printf("%s\n", err.msg);
+            free(frames);
+            goto out;
+        }
+
+        if (app.wnd && glfwWindowShouldClose(app.wnd)) {
+            save_progress(&app, &ckpt);
+            free(frames);
+            goto out;
+        }
+
+        render_batch(&app, frames, n);
+        for (int i = 0; i < n; i++) {
+            checkpoint_mark(&ckpt, frames[i].index);
+        }
+
+        since_save += n;
+        if (since_save >= app.checkpoint_interval) {
+            save_progress(&app, &ckpt);
+            since_save = 0;
+        }
+
+        if (app.wnd) {
+            framebuffer_present(&app.rend.target, app.w, app.h);
+            glfwSwapBuffers(app.wnd);
+            glfwPollEvents();  
+        }
+        framebuffer_bind(&app.rend.target);
+    }
+
+    free(frames);
+
+    save_progress(&app, &ckpt);
+    if (app.sprite_cache_path[0]) {
+        printf("sprite cache: %d of %d poses reused\n", sprite_hits, poses_count);
     }
 
-    for (i = 0; i < frames_count; i++) {
-        do {
-            rand_num = rand() % frames_count + 1;
-        } while (picked[rand_num/8] & (1 << rand_num%8)); // check if already picked
-        picked[rand_num/8] |= (1 << rand_num%8); // mark as picked
-        nums[i] = rand_num;
+    if (app.scene_loaded && app.rend.scene.lod_num > 1) {
+        printf("lod: level %u of %u drawn\n", app.rend.scene.lod, app.rend.scene.lod_num);
     }
+    if (app.rend.surface_draws) {
+        printf("culling: %llu of %llu surface draws skipped\n",
+               (unsigned long long)app.rend.surfaces_culled, (unsigned long long)app.rend.surface_draws);
+    }
+
+    glstate_counters binds = glstate_get_counters();
+    printf("gl binds: %llu issued, %llu elided\n",
+           (unsigned long long)binds.issued, (unsigned long long)binds.elided);
 
-    FILE *test_iset, *train_iset, *trainval_iset, *val_iset, *labels;
-    snprintf(filename, 64, "%s/test.txt", app.imagesets_path);
-    test_iset = fopen(filename, "w");
-    snprintf(filename, 64, "%s/train.txt", app.imagesets_path);
-    train_iset = fopen(filename, "w");
-    snprintf(filename, 64, "%s/trainval.txt", app.imagesets_path);
-    trainval_iset = fopen(filename, "w");
-    snprintf(filename, 64, "%s/val.txt", app.imagesets_path);
-    val_iset = fopen(filename, "w");
+    FILE *labels;
     snprintf(filename, 64, "%s/labels.txt", app.working_dir);
     labels = fopen(filename, "w");
 
     fputs(app.name, labels);
     fclose(labels);
 
-    for(int j = 0; j < frames_count; j++) {
-        if (j < frames_count/32) {
-            fprintf(test_iset, "%d\n", nums[j]);
-            fprintf(val_iset, "%d\n", nums[j]);
-        }
-        fprintf(train_iset, "%d\n", nums[j]);
-        fprintf(trainval_iset, "%d\n", nums[j]);
-    }
+    if (app.composites > 1) {
+        pose *split = frame_poses(&app, poses, poses_count);
 
-    free(nums);
+        err = split ? imageset_split(app.imagesets_path, split, poses_count * app.composites, app.split) : mrerror_new("malloc error");
+        free(split);
+    }
+    else {
+        err = imageset_split(app.imagesets_path, poses, poses_count, app.split);
+    }
+    if (err.err) {
+        printf("%s\n", err.msg);
+    }
 
-    fclose(test_iset);
-    fclose(train_iset);
-    fclose(trainval_iset);
-    fclose(val_iset);
+out:
+    if (app.baked.data) {
+        for (int i = 0; i < app.bg_count; i++) {
+            free(app.baked.data[i]);
+        }
+    }
+    free(app.baked.data);
+    free(app.baked.used);
+    free(app.baked.resident);
+    free(app.composite);
+    free(app.sprite);
+
+    manifest_close(&app.manifest);
+    checkpoint_close(&ckpt);
+    free(poses);
 }
 
 int main(int argc, char **argv)
@@ -445,12 +1372,27 @@ int main(int argc, char **argv)
 
     app.thermal = 0;
 
+    app.threads = 1;
+    app.checkpoint_interval = 256;
+    app.samples = 4;
+    app.batch = 1;
+    app.composites = 1;
+
+    app.seed = time(NULL);
+
+    app.split = (imageset_config){
+        .train = 30, .val = 1, .test = 1,
+        .stratify = IMAGESET_STRATIFY_NONE,
+        .bucket = 15,
+    };
+    app.filter = FILTER_NONE;
+
     int opt;
       
     // put ':' in the starting of the
     // string so that program can 
     //distinguish between '?' and ':' 
-    while((opt = getopt(argc, argv, "m:t:d:o:w:h:a:b:l:n:")) != -1) 
+    while((opt = getopt(argc, argv, "m:t:d:o:w:h:a:b:l:n:pxq:j:s:S:r:k:Rc:eA:B:L:K:C:O:P:F:QD:")) != -1) 
     { 
         switch(opt) 
         {
@@ -494,6 +1436,125 @@ int main(int argc, char **argv)
             case 'l':
                 app.thermal = 1;
                 break;
+            // 6-DoF pose and keypoints in annotations
+            case 'p':
+                app.pose_labels = 1;
+                break;
+            // annotations only, no rendering
+            case 'x':
+                app.relabel = 1;
+                break;
+            // pose manifest for relabeling
+            case 'q':
+                strncpy(app.pose_manifest_path, optarg, PATHBUF_SIZE - 1);
+                break;
+            // worker threads
+            case 'j':
+                app.threads = atoi(optarg);
+                break;
+            // train:val:test split ratios
+            case 's':
+                err = imageset_parse_ratios(&app.split, optarg);
+                if (err.err) {
+                    printf("%s\n", err.msg);
+                    return 1;
+                }
+                break;
+            // split stratification
+            case 'S':
+                err = imageset_parse_stratify(&app.split, optarg);
+                if (err.err) {
+                    printf("%s\n", err.msg);
+                    return 1;
+                }
+                break;
+            // pose acceptance rules
+            case 'F':
+                err = filter_parse(&app.filter, optarg);
+                if (err.err) {
+                    printf("%s\n", err.msg);
+                    return 1;
+                }
+                break;
+            // random seed
+            case 'r':
+                app.seed = strtoull(optarg, NULL, 0);
+                break;
+            // text manifest alongside manifest.bin
+            case 'k':
+                err = manifest_parse_format(&app.manifest_format, optarg);
+                if (err.err) {
+                    printf("%s\n", err.msg);
+                    return 1;
+                }
+                break;
+            // continue from checkpoint.bin
+            case 'R':
+                app.resume = 1;
+                break;
+            // frames between checkpoints
+            case 'c':
+                app.checkpoint_interval = atoi(optarg) > 0 ? atoi(optarg) : 1;
+                break;
+            // EGL, no window system
+            case 'e':
+                app.headless = 1;
+                break;
+            // MSAA samples, 0 disables
+            case 'A':
+                app.samples = atoi(optarg);
+                break;
+            // poses per atlas pass
+            case 'B':
+                app.batch = atoi(optarg) > 0 ? atoi(optarg) : 1;
+                break;
+            // poses per layered pass, one texture layer each
+            case 'L':
+                app.layers = atoi(optarg);
+                if (app.layers < 0) {
+                    app.layers = 0;
+                }
+                if (app.layers > LAYERS_MAX) {
+                    app.layers = LAYERS_MAX;
+                }
+                break;
+            // linked program binaries
+            case 'P':
+                strncpy(app.program_cache_path, optarg, PATHBUF_SIZE - 1);
+                break;
+            // 16 byte quantized vertices
+            case 'Q':
+                app.compact_vertices = 1;
+                break;
+            // levels of detail, pixels of error allowed
+            case 'D':
+                app.lod_pixels = atof(optarg) > 0 ? atof(optarg) : 0;
+                break;
+            // rgb lit or unlit, or mask or depth without backgrounds
+            case 'O':
+                app.unlit = 0;
+                if (!strcmp(optarg, "mask")) {
+                    app.output = OUTPUT_MASK;
+                }
+                else if (!strcmp(optarg, "depth")) {
+                    app.output = OUTPUT_DEPTH;
+                }
+                else if (!strcmp(optarg, "unlit")) {
+                    app.output = OUTPUT_RGB;
+                    app.unlit = 1;
+                }
+                else {
+                    app.output = OUTPUT_RGB;
+                }
+                break;
+            // frames per pose, one background each
+            case 'K':
+                app.composites = atoi(optarg) > 0 ? atoi(optarg) : 1;
+                break;
+            // sprite cache root, implies compositing
+            case 'C':
+                strncpy(app.sprite_cache_path, optarg, PATHBUF_SIZE - 1);
+                break;
             // name
             case 'n':
                 strncpy(app.name, optarg, 64);
@@ -508,6 +1569,37 @@ int main(int argc, char **argv)
         } 
     }
 
+    app.rend.cam = (camera){
+        {0, app.distance, 0},
+        {0, 0, 0},
+        45.0
+    };
+
+    if (app.relabel) {
+        if (!app.model_path[0] || !app.working_dir[0]) {
+            printf("select model and output path\n");
+            return 0;
+        }
+
+        // labels point at the frames of an earlier run
+        DIR *frames = opendir(app.frames_path);
+        if (frames == NULL) {
+            printf("no frames to relabel in %s\n", app.frames_path);
+            return 1;
+        }
+        closedir(frames);
+
+        rmkdir(app.annotations_path);
+        realpath_(app.frames_path, app.frames_fullpath);
+
+        err = relabel_main(&app);
+        if (err.err) {
+            printf("%s\n", err.msg);
+            return 1;
+        }
+        return 0;
+    }
+
     if (!app.model_path[0]   ||
         !app.texture_path[0] ||
         !app.background_images_path[0])
@@ -520,20 +1612,48 @@ int main(int argc, char **argv)
     rmkdir(app.frames_path);
     rmkdir(app.annotations_path);
     rmkdir(app.imagesets_path);
+    realpath_(app.frames_path, app.frames_fullpath);
 
-    err = initGLFW(&app);
+    if (app.headless) {
+#ifdef MR_EGL
+        err = initEGL(&app);
+#else
+        err = mrerror_new("built without EGL, reconfigure with -DMR_EGL=ON");
+#endif
+    }
+    else {
+        err = initGLFW(&app);
+    }
     if (err.err) {
         printf("%s\n", err.msg);
         return 1;
     }
 
+    if (app.program_cache_path[0]) {
+        rmkdir(app.program_cache_path);
+        shader_set_cache(app.program_cache_path);
+    }
+
     err = initGL(&app);
     if (err.err) {
         printf("%s\n", err.msg);
         return 1;
     }
 
-    err = load_background_textures(app.background_images_path, &app.bg_count, &app.backgrounds);
+    err = load_background_textures(app.background_images_path, app.w, app.h,
+                                   &app.bg_count, &app.backgrounds, &app.bg_layers, &app.bg_paths);
+    if (err.err) {
+        printf("%s\n", err.msg);
+        return 1;
+    }
+
+    // the sprite cache may make the scene unnecessary, otherwise load it
+    // while the shaders compile
+    if (!app.sprite_cache_path[0]) {
+        load_scene(&app);
+    }
+
+    err = initShaders(&app);
     if (err.err) {
         printf("%s\n", err.msg);
         return 1;
@@ -0,0 +1,311 @@
+#include "manifest.h"
+#include "fileio.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PATH_MAX_LEN 4096
+
+mrerror manifest_parse_format(int *format, const char *arg)
+{
+    if (!strcmp(arg, "csv")) {
+        *format = MANIFEST_TEXT_CSV;
+    }
+    else if (!strcmp(arg, "jsonl")) {
+        *format = MANIFEST_TEXT_JSONL;
+    }
+    else if (!strcmp(arg, "none")) {
+        *format = MANIFEST_TEXT_NONE;
+    }
+    else {
+        return mrerror_new("manifest format must be csv|jsonl|none");
+    }
+
+    return nilerr();
+}
+
+static void write_string(FILE *f, const char *str)
+{
+    uint16_t len = strlen(str);
+
+    fwrite(&len, sizeof(len), 1, f);
+    fwrite(str, 1, len, f);
+}
+
+static int read_string(FILE *f, char *buf)
+{
+    uint16_t len;
+
+    if (fread(&len, sizeof(len), 1, f) != 1 || len >= PATH_MAX_LEN) {
+        return 0;
+    }
+    if (fread(buf, 1, len, f) != len) {
+        return 0;
+    }
+    buf[len] = 0;
+
+    return 1;
+}
+
+static const char *text_names[] = {
+    [MANIFEST_TEXT_CSV]   = "manifest.csv",
+    [MANIFEST_TEXT_JSONL] = "manifest.jsonl",
+};
+
+// the old files are only replaced once the new ones are complete on disk
+static mrerror replace_files(manifest *m, const char *bin_path, const char *text_path)
+{
+    char tmp[PATH_MAX_LEN + 4];
+    int ok = 1;
+
+    ok = fileio_sync(m->bin) && ok;
+    ok = !fclose(m->bin) && ok;
+    m->bin = NULL;
+    if (m->text) {
+        ok = fileio_sync(m->text) && ok;
+        ok = !fclose(m->text) && ok;
+        m->text = NULL;
+    }
+    if (!ok) {
+        return mrerror_new("can't write manifest");
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", bin_path);
+    if (!fileio_replace(tmp, bin_path)) {
+        return mrerror_new("can't replace manifest");
+    }
+    if (m->text_format != MANIFEST_TEXT_NONE) {
+        snprintf(tmp, sizeof(tmp), "%s.tmp", text_path);
+        if (!fileio_replace(tmp, text_path)) {
+            return mrerror_new("can't replace text manifest");
+        }
+    }
+
+    return nilerr();
+}
+
+mrerror manifest_open(manifest *m, const char *dir, int text_format, int append, uint32_t keep,
+                      const char *frames_path, const char *annotations_path,
+                      char **backgrounds, int bg_count)
+{
+    char bin_path[PATH_MAX_LEN];
+    char text_path[PATH_MAX_LEN];
+    char tmp[PATH_MAX_LEN + 4];
+    uint32_t header[3] = {MANIFEST_MAGIC, MANIFEST_VERSION, bg_count};
+    manifest_record *kept = NULL;
+    int kept_num = 0;
+    mrerror err;
+
+    memset(m, 0, sizeof(manifest));
+    m->text_format = text_format;
+    m->frames_path = frames_path;
+    m->annotations_path = annotations_path;
+    m->backgrounds = backgrounds;
+
+    snprintf(bin_path, PATH_MAX_LEN, "%s/manifest.bin", dir);
+    snprintf(text_path, PATH_MAX_LEN, "%s/%s", dir, text_format != MANIFEST_TEXT_NONE ? text_names[text_format] : "");
+
+    // records past the checkpoint belong to frames that render again, a
+    // torn one from a crash goes with them
+    if (append && manifest_read(bin_path, &kept, &kept_num).err) {
+        kept = NULL;
+        kept_num = 0;
+    }
+    if ((uint32_t)kept_num > keep) {
+        kept_num = keep;
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", bin_path);
+    m->bin = fopen(tmp, "wb");
+    if (m->bin == NULL) {
+        free(kept);
+        return mrerror_new("can't open manifest");
+    }
+    if (text_format != MANIFEST_TEXT_NONE) {
+        snprintf(tmp, sizeof(tmp), "%s.tmp", text_path);
+        m->text = fopen(tmp, "w");
+        if (m->text == NULL) {
+            free(kept);
+            manifest_close(m);
+            return mrerror_new("can't open text manifest");
+        }
+    }
+
+    fwrite(header, sizeof(header), 1, m->bin);
+    for (int i = 0; i < bg_count; i++) {
+        write_string(m->bin, backgrounds[i]);
+    }
+    write_string(m->bin, frames_path);
+    write_string(m->bin, annotations_path);
+
+    if (text_format == MANIFEST_TEXT_CSV) {
+        fprintf(m->text, "id,yaw,pitch,background,background_path,seed,image,annotation\n");
+    }
+
+    for (int i = 0; i < kept_num; i++) {
+        manifest_write(m, &kept[i]);
+    }
+    free(kept);
+
+    err = replace_files(m, bin_path, text_path);
+    if (err.err) {
+        return err;
+    }
+
+    // new records go after the kept ones
+    m->bin = fopen(bin_path, "ab");
+    if (m->bin == NULL) {
+        return mrerror_new("can't open manifest");
+    }
+    if (text_format != MANIFEST_TEXT_NONE) {
+        m->text = fopen(text_path, "a");
+        if (m->text == NULL) {
+            manifest_close(m);
+            return mrerror_new("can't open text manifest");
+        }
+    }
+
+    return nilerr();
+}
+
+// RFC 4180, quoted only when the field needs it
+static void write_csv_field(FILE *f, const char *str)
+{
+    if (!str[strcspn(str, ",\"\r\n")]) {
+        fputs(str, f);
+        return;
+    }
+
+    fputc('"', f);
+    for (; *str; str++) {
+        if (*str == '"') {
+            fputc('"', f);
+        }
+        fputc(*str, f);
+    }
+    fputc('"', f);
+}
+
+static void write_json_string(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for (; *str; str++) {
+        unsigned char c = *str;
+
+        if (c == '"' || c == '\\') {
+            fprintf(f, "\\%c", c);
+        }
+        else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        }
+        else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+void manifest_write(manifest *m, const manifest_record *r)
+{
+    const char *bg_path = r->background >= 0 ? m->backgrounds[r->background] : "";
+    char image[PATH_MAX_LEN + 16];
+    char annotation[PATH_MAX_LEN + 16];
+
+    if (m->bin) {
+        fwrite(r, sizeof(manifest_record), 1, m->bin);
+        m->records++;
+    }
+
+    snprintf(image, sizeof(image), "%s/%u.png", m->frames_path, r->id);
+    snprintf(annotation, sizeof(annotation), "%s/%u.xml", m->annotations_path, r->id);
+
+    if (m->text_format == MANIFEST_TEXT_CSV) {
+        fprintf(m->text, "%u,%g,%g,%d,", r->id, r->yaw, r->pitch, r->background);
+        write_csv_field(m->text, bg_path);
+        fprintf(m->text, ",%llu,", (unsigned long long)r->seed);
+        write_csv_field(m->text, image);
+        fputc(',', m->text);
+        write_csv_field(m->text, annotation);
+        fputc('\n', m->text);
+    }
+    else if (m->text_format == MANIFEST_TEXT_JSONL) {
+        fprintf(m->text, "{\"id\":%u,\"yaw\":%g,\"pitch\":%g,\"background\":%d,\"background_path\":",
+                r->id, r->yaw, r->pitch, r->background);
+        write_json_string(m->text, bg_path);
+        fprintf(m->text, ",\"seed\":%llu,\"image\":", (unsigned long long)r->seed);
+        write_json_string(m->text, image);
+        fprintf(m->text, ",\"annotation\":");
+        write_json_string(m->text, annotation);
+        fprintf(m->text, "}\n");
+    }
+}
+
+void manifest_flush(manifest *m)
+{
+    if (m->bin) {
+        fileio_sync(m->bin);
+    }
+    if (m->text) {
+        fileio_sync(m->text);
+    }
+}
+
+void manifest_close(manifest *m)
+{
+    if (m->bin) {
+        fclose(m->bin);
+    }
+    if (m->text) {
+        fclose(m->text);
+    }
+
+    m->bin = NULL;
+    m->text = NULL;
+}
+
+mrerror manifest_read(const char *file, manifest_record **records, int *count)
+{
+    char path[PATH_MAX_LEN];
+    uint32_t header[3];
+    int cap = 1024;
+    FILE *f;
+
+    f = fopen(file, "rb");
+    if (f == NULL) {
+        return mrerror_new("can't open manifest");
+    }
+
+    if (fread(header, sizeof(header), 1, f) != 1 ||
+        header[0] != MANIFEST_MAGIC ||
+        header[1] != MANIFEST_VERSION)
+    {
+        fclose(f);
+        return mrerror_new("not a manifest");
+    }
+
+    // background table, frames and annotations paths
+    for (uint32_t i = 0; i < header[2] + 2; i++) {
+        if (!read_string(f, path)) {
+            fclose(f);
+            return mrerror_new("truncated manifest header");
+        }
+    }
+
+    *count = 0;
+    *records = malloc(cap * sizeof(manifest_record));
+
+    for (;;) {
+        if (*count == cap) {
+            cap *= 2;
+            *records = realloc(*records, cap * sizeof(manifest_record));
+        }
+        // a torn last record from an interrupted run is dropped
+        if (fread(&(*records)[*count], sizeof(manifest_record), 1, f) != 1) {
+            break;
+        }
+        (*count)++;
+    }
+
+    fclose(f);
+    return nilerr();
+}
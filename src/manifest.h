@@ -0,0 +1,52 @@
+#ifndef __MANIFEST_H__
+#define __MANIFEST_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "error.h"
+
+#define MANIFEST_MAGIC   0x464d524d // "MRMF"
+#define MANIFEST_VERSION 1
+
+enum {
+    MANIFEST_TEXT_NONE,
+    MANIFEST_TEXT_CSV,
+    MANIFEST_TEXT_JSONL,
+};
+
+// fixed size binary record, the header holds the background path table
+// and the image/annotation directories the ids resolve against
+typedef struct manifest_record {
+    uint32_t id;
+    float    yaw, pitch;
+    int32_t  background;
+    uint64_t seed;
+} manifest_record;
+
+typedef struct manifest {
+    FILE *bin;
+    FILE *text;
+    int   text_format;
+    uint32_t records;   // in manifest.bin, kept ones included
+
+    const char  *frames_path;
+    const char  *annotations_path;
+    char       **backgrounds;
+} manifest;
+
+mrerror manifest_parse_format(int *format, const char *arg);
+
+// append keeps the first keep records of an existing manifest.bin, the
+// ones a checkpoint counts, and rebuilds the text manifest from them
+mrerror manifest_open(manifest *m, const char *dir, int text_format, int append, uint32_t keep,
+                      const char *frames_path, const char *annotations_path,
+                      char **backgrounds, int bg_count);
+void manifest_write(manifest *m, const manifest_record *r);
+void manifest_flush(manifest *m);
+void manifest_close(manifest *m);
+
+// reads the records of a binary manifest, count is set to their number
+mrerror manifest_read(const char *file, manifest_record **records, int *count);
+
+#endif
@@ -1,43 +1,23 @@
 #include "mesh.h"
 
 #include <glad/glad.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "shader.h"
 #include "texture.h"
 #include "camera.h"
+#include "glstate.h"
+#include "simplify.h"
 
 #define CONF_NO_GL
 #include "obj.h"
 
-void mesh_init(mesh *m)
-{
-    glGenVertexArrays(1, &m->VAO);
-    glGenBuffers(1, &m->VBO);
-    glGenBuffers(1, &m->EBO);
-
-    glBindVertexArray(m->VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m->VBO);
-    glBufferData(GL_ARRAY_BUFFER, m->vert_num*sizeof(vertex), m->vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m->idx_num*sizeof(uint32_t), m->indices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)(sizeof(float)*3));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)(sizeof(float)*5));
-    glEnableVertexAttribArray(2);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
-    glBindVertexArray(0); 
-}
+// post-transform cache entries assumed by obj_sort and obj_acmr
+#define MESH_VERTEX_CACHE 16
 
 mesh mesh_new_quad()
 {
@@ -55,78 +35,23 @@ mesh mesh_new_quad()
     glGenVertexArrays(1, &quad.VAO);
     glGenBuffers(1, &quad.VBO);
 
-    glBindVertexArray(quad.VAO);
+    glstate_bind_vertex_array(quad.VAO);
     
-    glBindBuffer(GL_ARRAY_BUFFER, quad.VBO);
+    glstate_bind_buffer(GL_ARRAY_BUFFER, quad.VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
     glEnableVertexAttribArray(0);  
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
+    glstate_bind_buffer(GL_ARRAY_BUFFER, 0); 
 
-    glBindVertexArray(0); 
+    glstate_bind_vertex_array(0); 
 
     quad.vert_num = 6;
 
     return quad;
 }
 
-void mesh_init_push(mesh **head, int vbo, uint32_t *indices, int indices_num, const char *tex)
-{
-    mesh *last;
-    char image_path[64];
-
-    if (!*head) {
-        *head = calloc(1, sizeof(mesh));
-        last = *head;
-    }
-    else {
-        last = *head;
-        while (last->next) {
-            last = last->next;
-        }
-
-        last->next = malloc(sizeof(mesh));
-        last = last->next;
-    }
-
-    last->idx_num = indices_num;
-    last->next = NULL;
-    last->nested = NULL;
-    last->rotation[0] = 0;
-    last->rotation[1] = 0;
-    last->rotation[2] = 0;
-    last->renderable = 1;
-
-
-    if (texture_find(&last->texture, tex).err) {
-        printf("Can't load %s, skipping\n", image_path);
-    }
-
-    glGenVertexArrays(1, &last->VAO);
-    glGenBuffers(1, &last->EBO);
-
-    glBindVertexArray(last->VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, last->EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_num*sizeof(uint32_t), indices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)(sizeof(float)*3));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)(sizeof(float)*5));
-    glEnableVertexAttribArray(2);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0); 
-    glBindVertexArray(0); 
-}
-
 void get_bounding_box(mesh *m)
 {
     vec3 min = {m->vertices[0].position[0], m->vertices[0].position[1], m->vertices[0].position[2]};
@@ -163,22 +88,288 @@ void get_bounding_box(mesh *m)
     return;
 }
 
-mesh mesh_load_obj(const char *file, const char *tex)
+mrerror mesh_load_bounds(const char *file, float *bound_box)
 {
-    mesh *root;
+    mesh m = {0};
+    obj *o;
+
+    o = obj_create(file);
+    if (o == NULL) {
+        return mrerror_new("obj_create");
+    }
+
+    m.vert_num = obj_num_vert(o);
+    if (m.vert_num == 0) {
+        obj_delete(o);
+        return mrerror_new("model has no vertices");
+    }
+
+    m.vertices = calloc(m.vert_num, sizeof(vertex));
+    for (int i = 0; i < m.vert_num; i++) {
+        obj_get_vert_v(o, i, m.vertices[i].position);
+    }
+
+    get_bounding_box(&m);
+    memcpy(bound_box, m.bound_box, sizeof(m.bound_box));
+
+    free(m.vertices);
+    obj_delete(o);
+
+    return nilerr();
+}
+
+// renumbers vertices in order of first use so the vertex fetch walks the
+// VBO forwards, unreferenced ones keep their place after the rest
+static void remap_vertices(vertex *vertices, uint32_t vert_num, uint32_t *indices, uint32_t idx_num)
+{
+    uint32_t *remap = malloc(vert_num * sizeof(uint32_t));
+    vertex *sorted = malloc(vert_num * sizeof(vertex));
+    uint32_t next = 0;
+
+    if (!remap || !sorted) {
+        free(remap);
+        free(sorted);
+        return;
+    }
+
+    memset(remap, 0xff, vert_num * sizeof(uint32_t));
+    for (uint32_t i = 0; i < idx_num; i++) {
+        if (remap[indices[i]] == UINT32_MAX) {
+            remap[indices[i]] = next++;
+        }
+        indices[i] = remap[indices[i]];
+    }
+    for (uint32_t i = 0; i < vert_num; i++) {
+        if (remap[i] == UINT32_MAX) {
+            remap[i] = next++;
+        }
+        sorted[remap[i]] = vertices[i];
+    }
+
+    memcpy(vertices, sorted, vert_num * sizeof(vertex));
+    free(sorted);
+    free(remap);
+}
+
+// round to nearest, overflow goes to infinity and tiny values to zero
+static uint16_t float_to_half(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+
+    uint16_t sign = (x >> 16) & 0x8000;
+    int32_t exp = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+
+    if (((x >> 23) & 0xff) == 0xff) {
+        return sign | 0x7c00 | (mant ? 0x200 : 0);
+    }
+    if (exp >= 31) {
+        return sign | 0x7c00;
+    }
+    if (exp <= 0) {
+        if (exp < -10) {
+            return sign;
+        }
+        mant |= 0x800000;
+        int shift = 14 - exp;
+        return sign | ((mant >> shift) + ((mant >> (shift - 1)) & 1));
+    }
+
+    // a carry out of the mantissa correctly bumps the exponent
+    return (sign | (exp << 10) | (mant >> 13)) + ((mant >> 12) & 1);
+}
+
+// unit normal to the octahedron folded onto the z >= 0 square
+static void oct_encode(const float *n, int16_t *out)
+{
+    float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = l1 > 0 ? n[0] / l1 : 0;
+    float y = l1 > 0 ? n[1] / l1 : 0;
+
+    if (n[2] < 0) {
+        float fx = (1.0f - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f);
+        float fy = (1.0f - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+
+    out[0] = (int16_t)roundf(x * 32767.0f);
+    out[1] = (int16_t)roundf(y * 32767.0f);
+}
+
+static void upload_compact(mesh *m, const vertex *vertices)
+{
+    compact_vertex *packed = malloc(m->vert_num * sizeof(compact_vertex));
+    vec3 min, max;
+
+    // bound_box corners 4 and 2 are the min and max
+    glm_vec3_copy(&m->bound_box[4*4], min);
+    glm_vec3_copy(&m->bound_box[2*4], max);
+    glm_vec3_copy(min, m->quant_offset);
+    glm_vec3_sub(max, min, m->quant_scale);
+
+    for (uint32_t i = 0; i < m->vert_num; i++) {
+        for (int k = 0; k < 3; k++) {
+            float t = m->quant_scale[k] > 0 ? (vertices[i].position[k] - min[k]) / m->quant_scale[k] : 0;
+            packed[i].position[k] = (uint16_t)roundf(glm_clamp(t, 0, 1) * 65535.0f);
+        }
+        packed[i].position[3] = 0;
+
+        oct_encode(vertices[i].normal, packed[i].normal);
+        packed[i].texture[0] = float_to_half(vertices[i].texture[0]);
+        packed[i].texture[1] = float_to_half(vertices[i].texture[1]);
+    }
+
+    glBufferData(GL_ARRAY_BUFFER, m->vert_num * sizeof(compact_vertex), packed, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(compact_vertex), (void *)offsetof(compact_vertex, position));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(compact_vertex), (void *)offsetof(compact_vertex, texture));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(compact_vertex), (void *)offsetof(compact_vertex, normal));
+    glEnableVertexAttribArray(2);
+
+    free(packed);
+}
+
+// indices rebased on each surface's lowest vertex, 16 bits wide when
+// every surface fits; returns the GL index type
+static uint32_t upload_indices(mesh *m, uint32_t *indices)
+{
+    int narrow = 1;
+
+    for (uint32_t i = 0; i < m->lod_num * m->surf_num; i++) {
+        surface *surf = &m->surfaces[i];
+        uint32_t lo = UINT32_MAX, hi = 0;
+
+        if (surf->idx_num == 0) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < surf->idx_num; j++) {
+            uint32_t idx = indices[surf->first_index + j];
+
+            lo = idx < lo ? idx : lo;
+            hi = idx > hi ? idx : hi;
+        }
+        for (uint32_t j = 0; j < surf->idx_num; j++) {
+            indices[surf->first_index + j] -= lo;
+        }
+
+        surf->base_vertex = lo;
+        narrow = narrow && hi - lo <= UINT16_MAX;
+    }
+
+    if (!narrow) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m->idx_num * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+        return GL_UNSIGNED_INT;
+    }
+
+    uint16_t *narrowed = malloc(m->idx_num * sizeof(uint16_t));
+    for (uint32_t i = 0; i < m->idx_num; i++) {
+        narrowed[i] = (uint16_t)indices[i];
+    }
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m->idx_num * sizeof(uint16_t), narrowed, GL_STATIC_DRAW);
+    free(narrowed);
+
+    return GL_UNSIGNED_SHORT;
+}
+
+// appends each level's triangles to indices, level by level, with every
+// level halving the one before until simplification stalls
+static void build_lods(mesh *m, const vertex *vertices, uint32_t **indices, const char *file)
+{
+    uint32_t tri_num = m->idx_num / 3;
+    uint32_t *groups = malloc(tri_num * sizeof(uint32_t));
+    simplifier sim;
+
+    m->lod_num = 1;
+    if (!groups) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < m->surf_num; i++) {
+        for (uint32_t t = 0; t < m->surfaces[i].idx_num / 3; t++) {
+            groups[m->surfaces[i].first_index / 3 + t] = i;
+        }
+    }
+
+    if (simplifier_new(&sim, vertices, m->vert_num, *indices, groups, tri_num).err) {
+        free(groups);
+        return;
+    }
+    free(groups);
+
+    while (m->lod_num < MESH_LODS && tri_num > 64) {
+        uint32_t left = simplifier_run(&sim, tri_num / 2);
+
+        // not worth a level of its own
+        if (left > tri_num * 3 / 4) {
+            break;
+        }
+
+        uint32_t *grown = realloc(*indices, (m->idx_num + left*3) * sizeof(uint32_t));
+        surface *surfaces = realloc(m->surfaces, (m->lod_num + 1) * m->surf_num * sizeof(surface));
+        if (surfaces) {
+            m->surfaces = surfaces;
+        }
+        if (!grown || !surfaces) {
+            *indices = grown ? grown : *indices;
+            break;
+        }
+        *indices = grown;
+
+        // triangles keep their order, so each surface is still one run
+        surface *level = m->surfaces + m->lod_num * m->surf_num;
+        for (uint32_t i = 0, t = 0; i < m->surf_num; i++) {
+            uint32_t first = t;
+
+            while (t < left && sim.groups[t] == i) {
+                t++;
+            }
+
+            level[i] = m->surfaces[i];
+            level[i].first_index = m->idx_num + first*3;
+            level[i].idx_num = (t - first)*3;
+        }
+
+        memcpy(*indices + m->idx_num, sim.indices, left*3 * sizeof(uint32_t));
+        m->idx_num += left*3;
+        m->lod_error[m->lod_num] = sim.error;
+        m->lod_num++;
+
+        printf("%s: LOD %u, %u triangles, error %g\n", file, m->lod_num - 1, left, sim.error);
+        tri_num = left;
+    }
+
+    simplifier_free(&sim);
+}
+
+mesh mesh_load_obj(const char *file, const char *tex, int flags)
+{
+    mesh root = {0};
     obj *o;
     vertex *vertices;
+    uint32_t *indices;
+    uint32_t *materials;
+    draw_command *cmds;
     int verts_num;
     int surf_num;
-    int vbo;
-
-    root = calloc(1, sizeof(mesh));
+    int indices_num = 0;
 
     o = obj_create(file);
     surf_num = obj_num_surf(o);
     verts_num = obj_num_vert(o);
 
-    root->vert_num = verts_num;
+    // triangles of each surface reordered for the post-transform cache
+    float acmr = obj_acmr(o, MESH_VERTEX_CACHE);
+    obj_sort(o, MESH_VERTEX_CACHE);
+    printf("%s: ACMR %.3f -> %.3f\n", file, acmr, obj_acmr(o, MESH_VERTEX_CACHE));
+
+    root.vert_num = verts_num;
 
     vertices = calloc(verts_num, sizeof(vertex));
     for (int i = 0; i < verts_num; i++) {
@@ -186,69 +377,268 @@ mesh mesh_load_obj(const char *file, const char *tex)
         obj_get_vert_n(o, i, vertices[i].normal);
         obj_get_vert_t(o, i, vertices[i].texture);
     }
-    root->vertices = vertices;
+    root.vertices = vertices;
 
-    get_bounding_box(root);
+    get_bounding_box(&root);
 
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, verts_num * sizeof(vertex), vertices, GL_STATIC_DRAW);    
+    for (int i = 0; i < surf_num; i++) {
+        indices_num += obj_num_poly(o, i)*3;
+    }
 
-    free(vertices);
+    // every surface appended to one index buffer
+    root.surfaces = calloc(surf_num, sizeof(surface));
+    indices = malloc(indices_num * sizeof(uint32_t));
+    root.idx_num = indices_num;
 
-    for (int i = 0; i < surf_num; i++) {
-        int *indices;
-        int indices_num;
-        int idx_index = 0;
+    for (int i = 0, offset = 0; i < surf_num; i++) {
+        int polys = obj_num_poly(o, i);
 
-        indices_num = obj_num_poly(o, i)*3;
-        indices = malloc(indices_num * sizeof(uint32_t));
+        if (polys == 0) {
+            continue;
+        }
 
-        for (int j = 0; j < indices_num/3; j++) {
-            obj_get_poly(o, i, j, &indices[idx_index]);
-            idx_index += 3;
+        for (int j = 0; j < polys; j++) {
+            obj_get_poly(o, i, j, (int *)&indices[offset + j*3]);
         }
-        mesh_init_push(&root->nested, vbo, indices, indices_num, tex);
 
-        free(indices);
+        // all surfaces are textured with tex for now, a single material
+        surface *surf = &root.surfaces[root.surf_num++];
+        *surf = (surface){
+            .first_index = offset,
+            .idx_num = polys*3,
+            .material = 0,
+        };
+
+        glm_vec3_copy(vertices[indices[offset]].position, surf->min);
+        glm_vec3_copy(vertices[indices[offset]].position, surf->max);
+        for (int j = 1; j < polys*3; j++) {
+            glm_vec3_minv(surf->min, vertices[indices[offset + j]].position, surf->min);
+            glm_vec3_maxv(surf->max, vertices[indices[offset + j]].position, surf->max);
+        }
+        offset += polys*3;
+    }
+
+    root.lod_num = 1;
+    if (flags & MESH_LOAD_LODS) {
+        build_lods(&root, vertices, &indices, file);
+        indices_num = root.idx_num;
+    }
+
+    remap_vertices(vertices, verts_num, indices, indices_num);
+
+    if (texture_new_array(&root.materials, &tex, 1).err) {
+        printf("Can't load %s, skipping\n", tex);
     }
 
+    glGenVertexArrays(1, &root.VAO);
+    glGenBuffers(1, &root.VBO);
+    glGenBuffers(1, &root.EBO);
+    glGenBuffers(1, &root.MBO);
+    glGenBuffers(1, &root.IBO);
+
+    glstate_bind_vertex_array(root.VAO);
+
+    glstate_bind_buffer(GL_ARRAY_BUFFER, root.VBO);
+    root.compact = (flags & MESH_LOAD_COMPACT) != 0;
+    if (root.compact) {
+        upload_compact(&root, vertices);
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, verts_num * sizeof(vertex), vertices, GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), 0);
+        glEnableVertexAttribArray(0);
+
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)(sizeof(float)*3));
+        glEnableVertexAttribArray(1);
+
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)(sizeof(float)*5));
+        glEnableVertexAttribArray(2);
+    }
+
+    glstate_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, root.EBO);
+    root.index_type = upload_indices(&root, indices);
+
+    cmds = calloc(root.surf_num, sizeof(draw_command));
+    materials = calloc(root.surf_num, sizeof(uint32_t));
+    for (uint32_t i = 0; i < root.surf_num; i++) {
+        cmds[i] = (draw_command){
+            .count = root.surfaces[i].idx_num,
+            .instance_count = 1,
+            .first_index = root.surfaces[i].first_index,
+            .base_vertex = root.surfaces[i].base_vertex,
+            .base_instance = i,
+        };
+        materials[i] = root.surfaces[i].material;
+    }
+    root.instances = 1;
+
+    // instanced attribute that never advances, so every vertex of a draw
+    // reads materials[base_instance] no matter how many instances it has
+    glstate_bind_buffer(GL_ARRAY_BUFFER, root.MBO);
+    glBufferData(GL_ARRAY_BUFFER, root.surf_num * sizeof(uint32_t), materials, GL_STATIC_DRAW);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(uint32_t), 0);
+    glVertexAttribDivisor(3, 0x7fffffff);
+    glEnableVertexAttribArray(3);
+
+    glstate_bind_buffer(GL_DRAW_INDIRECT_BUFFER, root.IBO);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, root.surf_num * sizeof(draw_command), cmds, GL_DYNAMIC_DRAW);
+
+    glstate_bind_buffer(GL_ARRAY_BUFFER, 0); 
+    glstate_bind_vertex_array(0); 
+
+    free(materials);
+    free(cmds);
+    free(indices);
+    free(vertices);
+    root.vertices = NULL;
+
     obj_delete(o);
 
-    return *root;
+    return root;
 }
 
-void mesh_render(mesh m, shader s, mat4 model)
+// 0 when all 8 corners are outside one clip plane
+static int box_visible(mat4 mvp, const vec3 min, const vec3 max)
 {
-    mesh *m_temp;
+    int outside[6] = {0};
+
+    for (int i = 0; i < 8; i++) {
+        vec4 corner = {i & 1 ? max[0] : min[0], i & 2 ? max[1] : min[1], i & 4 ? max[2] : min[2], 1.0f};
+        vec4 clip;
+
+        glm_mat4_mulv(mvp, corner, clip);
+        outside[0] += clip[0] < -clip[3];
+        outside[1] += clip[0] >  clip[3];
+        outside[2] += clip[1] < -clip[3];
+        outside[3] += clip[1] >  clip[3];
+        outside[4] += clip[2] < -clip[3];
+        outside[5] += clip[2] >  clip[3];
+    }
 
-    glUseProgram(s);
-    camera_transform_mesh(s, m, model);
+    for (int p = 0; p < 6; p++) {
+        if (outside[p] == 8) {
+            return 0;
+        }
+    }
+    return 1;
+}
 
-    if (m.renderable) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m.texture);
-    
-        glBindVertexArray(m.VAO); 
-        glDrawElements(GL_TRIANGLES, m.idx_num, GL_UNSIGNED_INT, 0);
+uint32_t mesh_cull(mesh *m, stream_buffer *sb, mat4 *mvps, int n)
+{
+    size_t offset;
+    draw_command *cmds = stream_alloc(sb, m->surf_num * sizeof(draw_command), &offset);
+
+    // a command list bigger than a stream slot is drawn whole from IBO,
+    // at full detail
+    m->draw_buffer = 0;
+    if (!cmds) {
+        return m->surf_num;
     }
 
-    m_temp = m.nested;
+    m->draw_num = 0;
+    for (uint32_t i = 0; i < m->surf_num; i++) {
+        const surface *surf = &m->surfaces[m->lod * m->surf_num + i];
+        int visible = 0;
+
+        if (surf->idx_num == 0) {
+            continue;
+        }
+
+        for (int j = 0; j < n && !visible; j++) {
+            visible = box_visible(mvps[j], surf->min, surf->max);
+        }
+        if (!visible) {
+            continue;
+        }
 
-    while (m_temp) {
-        mesh_render(*m_temp, s, model);
-        m_temp = m_temp->next;
+        cmds[m->draw_num++] = (draw_command){
+            .count = surf->idx_num,
+            .instance_count = n,
+            .first_index = surf->first_index,
+            .base_vertex = surf->base_vertex,
+            .base_instance = i,
+        };
     }
+
+    m->draw_buffer = sb->buffer;
+    m->draw_offset = offset;
+
+    return m->draw_num;
+}
+
+void mesh_select_lod(mesh *m, float tolerance)
+{
+    m->lod = 0;
+    while (m->lod + 1 < m->lod_num && m->lod_error[m->lod + 1] <= tolerance) {
+        m->lod++;
+    }
+}
+
+static void mesh_draw(const mesh *m)
+{
+    glstate_bind_texture(0, GL_TEXTURE_2D_ARRAY, m->materials);
+
+    glstate_bind_vertex_array(m->VAO);
+    if (m->draw_buffer) {
+        if (m->draw_num == 0) {
+            return;
+        }
+        glstate_bind_buffer(GL_DRAW_INDIRECT_BUFFER, m->draw_buffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, m->index_type, (void *)m->draw_offset, m->draw_num, 0);
+        return;
+    }
+
+    glstate_bind_buffer(GL_DRAW_INDIRECT_BUFFER, m->IBO);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, m->index_type, 0, m->surf_num, 0);
+}
+
+// the dequantization uniforms are set once per program
+static void mesh_use_program(mesh *m, const shader *s)
+{
+    glstate_use_program(s->program);
+
+    if (m->compact && m->quant_program != s->program) {
+        glProgramUniform3fv(s->program, s->slots[SHADER_QUANT_OFFSET], 1, m->quant_offset);
+        glProgramUniform3fv(s->program, s->slots[SHADER_QUANT_SCALE], 1, m->quant_scale);
+        m->quant_program = s->program;
+    }
+}
+
+void mesh_render(mesh *m, const shader *s)
+{
+    mesh_use_program(m, s);
+
+    mesh_draw(m);
+}
+
+// one matrix per instance in the Models block, see camera_transform_instances
+void mesh_render_instanced(mesh *m, const shader *s, int instances)
+{
+    mesh_use_program(m, s);
+
+    if (!m->draw_buffer && m->instances != (uint32_t)instances) {
+        glstate_bind_buffer(GL_DRAW_INDIRECT_BUFFER, m->IBO);
+        draw_command *cmds = glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, m->surf_num * sizeof(draw_command),
+                                              GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+        for (uint32_t i = 0; i < m->surf_num; i++) {
+            cmds[i].instance_count = instances;
+        }
+        glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+        m->instances = instances;
+    }
+
+    mesh_draw(m);
 }
 
-void mesh_render_quad(mesh m, shader s)
+void mesh_render_quad(const mesh *m, const shader *s, int count)
 {
-    glUseProgram(s);
+    glstate_use_program(s->program);
 
-    glBindVertexArray(m.VAO);
+    glstate_bind_vertex_array(m->VAO);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m.texture);
+    // next to the material array, neither is rebound between draws
+    glstate_bind_texture(1, GL_TEXTURE_2D_ARRAY, m->texture);
 
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, count);
 }
@@ -3,6 +3,15 @@
 
 #include <cglm/cglm.h>
 #include "shader.h"
+#include "stream.h"
+
+// levels of detail, the first is the model as loaded
+#define MESH_LODS 8
+
+enum {
+    MESH_LOAD_COMPACT = 1 << 0,  // compact_vertex layout, see COMPACT_VERTICES
+    MESH_LOAD_LODS    = 1 << 1,  // simplified levels next to the original
+};
 
 typedef struct vertex {
     vec3 position;
@@ -10,6 +19,33 @@ typedef struct vertex {
     vec3 normal;
 } vertex;
 
+// GL layout of the COMPACT_VERTICES shader variant, 16 bytes
+typedef struct compact_vertex {
+    uint16_t position[4]; // unorm within the mesh bounds, w unused
+    int16_t  normal[2];   // snorm octahedral
+    uint16_t texture[2];  // half float
+} compact_vertex;
+
+// one obj surface, a range of the shared EBO
+typedef struct surface {
+    uint32_t first_index;
+    uint32_t idx_num;
+    int32_t  base_vertex; // indices are relative to the surface's first vertex
+    uint32_t material;  // layer in the mesh's materials array
+
+    // model space bounds of the surface's vertices
+    vec3 min, max;
+} surface;
+
+// GL layout of glMultiDrawElementsIndirect commands
+typedef struct draw_command {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t  base_vertex;
+    uint32_t base_instance;
+} draw_command;
+
 typedef struct mesh {
     vec3 position;
     vec3 rotation;
@@ -23,19 +59,60 @@ typedef struct mesh {
     uint32_t  texture;
 
     uint32_t VAO, VBO, EBO;
+    uint32_t index_type;  // GL_UNSIGNED_SHORT when every surface spans < 64k vertices
+
+    // compact positions decode to offset + position * scale
+    int      compact;
+    vec3     quant_offset, quant_scale;
+    uint32_t quant_program; // last program given the two above
 
 
     float bound_box[4*8];
 
-    char        *name;
-    struct mesh *next;
-    struct mesh *nested;
-    int          renderable; 
+    char *name;
+
+    // flat draw list, all surfaces share the mesh transform, VAO and
+    // buffers and are drawn by one indirect call from IBO
+    surface  *surfaces;
+    uint32_t  surf_num;
+
+    // level l's surfaces are surfaces[l*surf_num ...], same materials and
+    // bounds, its largest deviation from level 0 is lod_error[l]
+    uint32_t  lod_num;
+    uint32_t  lod;  // level drawn by mesh_cull
+    float     lod_error[MESH_LODS];
+
+    uint32_t  IBO;
+    uint32_t  instances;  // instance_count of the uploaded commands
+
+    // commands of the surfaces mesh_cull kept, drawn instead of IBO
+    // when draw_buffer is set
+    uint32_t  draw_buffer;
+    size_t    draw_offset;
+    uint32_t  draw_num;
+
+    // per surface material, read through base_instance
+    uint32_t  MBO;
+    uint32_t  materials;  // GL_TEXTURE_2D_ARRAY
 } mesh;
 
 mesh mesh_new_quad();
-mesh mesh_load_obj(const char *file, const char *tex);
+// flags are MESH_LOAD_*
+mesh mesh_load_obj(const char *file, const char *tex, int flags);
+
+// CPU only, fills bound_box without creating any GL objects
+mrerror mesh_load_bounds(const char *file, float *bound_box);
+
+// Writes draw commands for the surfaces of level lod inside at least one
+// of the n frusta to the stream, n instances each, for the next mesh_render or
+// mesh_render_instanced. Returns the number of surfaces kept.
+uint32_t mesh_cull(mesh *m, stream_buffer *sb, mat4 *mvps, int n);
+
+// picks the coarsest level whose error stays within tolerance model units
+void mesh_select_lod(mesh *m, float tolerance);
 
-void mesh_render(mesh m, shader s, mat4 model);
-void mesh_render_quad(mesh m, shader s);
+// the Models block is expected to be bound, see camera_transform_mesh
+void mesh_render(mesh *m, const shader *s);
+void mesh_render_instanced(mesh *m, const shader *s, int instances);
+void mesh_render_quad(const mesh *m, const shader *s, int count);
 #endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "pose.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "manifest.h"
+
+int pose_grid(int ys, int ye, int ps, int pe, pose **poses)
+{
+    int count = 0;
+    int yaw_num = ye/5 - ys/5 + 1;
+    int pitch_num = pe/5 - ps/5 + 1;
+
+    *poses = NULL;
+    if (yaw_num <= 0 || pitch_num <= 0) {
+        return 0;
+    }
+
+    *poses = malloc(yaw_num * pitch_num * sizeof(pose));
+
+    for (int x = ys/5; x <= ye/5; x++) {
+        for (int y = ps/5; y <= pe/5; y++) {
+            (*poses)[count].id = count + 1;
+            (*poses)[count].yaw = x*5;
+            (*poses)[count].pitch = y*5;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static mrerror pose_manifest_read_bin(const char *file, pose **poses, int *count)
+{
+    manifest_record *records;
+    mrerror err;
+
+    err = manifest_read(file, &records, count);
+    if (err.err) {
+        return err;
+    }
+
+    *poses = malloc((*count + 1) * sizeof(pose));
+    for (int i = 0; i < *count; i++) {
+        (*poses)[i].id = records[i].id;
+        (*poses)[i].yaw = records[i].yaw;
+        (*poses)[i].pitch = records[i].pitch;
+    }
+
+    free(records);
+    return nilerr();
+}
+
+mrerror pose_manifest_read(const char *file, pose **poses, int *count)
+{
+    char line[1024];
+    int cap = 1024;
+    uint32_t magic = 0;
+    FILE *f;
+
+    f = fopen(file, "r");
+    if (f == NULL) {
+        return mrerror_new("can't open pose manifest");
+    }
+
+    if (fread(&magic, sizeof(magic), 1, f) == 1 && magic == MANIFEST_MAGIC) {
+        fclose(f);
+        return pose_manifest_read_bin(file, poses, count);
+    }
+    rewind(f);
+
+    *count = 0;
+    *poses = malloc(cap * sizeof(pose));
+
+    while (fgets(line, sizeof(line), f)) {
+        unsigned int id;
+        float yaw, pitch;
+
+        if (line[0] == '{') {
+            if (sscanf(line, "{\"id\":%u,\"yaw\":%f,\"pitch\":%f", &id, &yaw, &pitch) != 3) {
+                continue;
+            }
+        }
+        else if (!isdigit((unsigned char)line[0]) ||
+                 sscanf(line, "%u,%f,%f", &id, &yaw, &pitch) != 3)
+        {
+            continue;
+        }
+
+        if (*count == cap) {
+            cap *= 2;
+            *poses = realloc(*poses, cap * sizeof(pose));
+        }
+
+        (*poses)[*count].id = id;
+        (*poses)[*count].yaw = yaw;
+        (*poses)[*count].pitch = pitch;
+        (*count)++;
+    }
+
+    fclose(f);
+    return nilerr();
+}
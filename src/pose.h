@@ -0,0 +1,20 @@
+#ifndef __POSE_H__
+#define __POSE_H__
+
+#include <stdint.h>
+
+#include "error.h"
+
+typedef struct pose {
+    uint32_t id;
+    float yaw, pitch; // degrees
+} pose;
+
+// enumerates the -a angle grid in render order, ids start at 1
+int pose_grid(int ys, int ye, int ps, int pe, pose **poses);
+
+// reads a binary manifest, or "id,yaw,pitch[,...]" csv and manifest jsonl
+// lines, anything else is skipped
+mrerror pose_manifest_read(const char *file, pose **poses, int *count);
+
+#endif
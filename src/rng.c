@@ -0,0 +1,32 @@
+#include "rng.h"
+
+void rng_seed(rng *r, uint64_t seed)
+{
+    r->state = seed;
+}
+
+uint64_t rng_next(rng *r)
+{
+    uint64_t z = (r->state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Lemire's multiply and reject
+uint32_t rng_range(rng *r, uint32_t n)
+{
+    uint64_t m = (uint64_t)(uint32_t)rng_next(r) * n;
+    uint32_t low = (uint32_t)m;
+
+    if (low < n) {
+        uint32_t threshold = -n % n;
+        while (low < threshold) {
+            m = (uint64_t)(uint32_t)rng_next(r) * n;
+            low = (uint32_t)m;
+        }
+    }
+
+    return m >> 32;
+}
@@ -0,0 +1,17 @@
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include <stdint.h>
+
+// splitmix64, the whole state is one word so it can be saved and restored
+typedef struct rng {
+    uint64_t state;
+} rng;
+
+void rng_seed(rng *r, uint64_t seed);
+uint64_t rng_next(rng *r);
+
+// unbiased value in [0, n)
+uint32_t rng_range(rng *r, uint32_t n);
+
+#endif
@@ -6,75 +6,374 @@
 #include <sys/stat.h>
 #include <malloc.h>
 #include <unistd.h>
+#include <string.h>
 
 #include "error.h"
+#include "fileio.h"
+#include "hash.h"
 
-mrerror shader_compile(uint32_t *s, int type, const char *file)
+// #version has to stay first, so the defines go right after it and a
+// #line directive keeps compiler messages on the file's own line numbers
+static char *shader_specialize(const char *source, const char *defines)
+{
+    const char *body = source;
+    size_t size = strlen(source) + 32;
+    char *out, *p;
+
+    if (!strncmp(source, "#version", 8)) {
+        body = strchr(source, '\n');
+        body = body ? body + 1 : source + strlen(source);
+    }
+
+    // each word of defines becomes "#define WORD\n", 9 bytes more than the word
+    size += defines ? (strlen(defines) + 1) * 10 : 0;
+    out = malloc(size);
+    p = out;
+
+    memcpy(p, source, body - source);
+    p += body - source;
+
+    while (defines && *defines) {
+        size_t len = strcspn(defines, " \n");
+
+        if (len) {
+            p += sprintf(p, "#define %.*s\n", (int)len, defines);
+        }
+        defines += len;
+        defines += strspn(defines, " \n");
+    }
+
+    if (body != source) {
+        p += sprintf(p, "#line 2\n");
+    }
+    strcpy(p, body);
+
+    return out;
+}
+
+static char *shader_read(const char *file)
 {
     int shader_fd;
     struct stat file_stat;
     char *shader_source;
 
     shader_fd = open(file, O_RDONLY);
-    if (shader_fd <= 0) {
-        return mrerror_new("cant load shader lmao");
+    if (shader_fd < 0) {
+        return NULL;
     }
     fstat(shader_fd, &file_stat);
 
     shader_source = malloc(file_stat.st_size + 1);
     if (read(shader_fd, shader_source, file_stat.st_size) != file_stat.st_size) {
-        goto err_read;
+        close(shader_fd);
+        free(shader_source);
+        return NULL;
     }
+    close(shader_fd);
     shader_source[file_stat.st_size] = 0;
 
-    *s = glCreateShader(type);
-    glShaderSource(*s, 1, (const GLchar *const *)&shader_source, NULL);
-    glCompileShader(*s);
+    return shader_source;
+}
+
+// submits only, the status is read in shader_finish
+static uint32_t shader_compile(int type, const char *source)
+{
+    uint32_t s = glCreateShader(type);
+
+    glShaderSource(s, 1, (const GLchar *const *)&source, NULL);
+    glCompileShader(s);
 
-    free(shader_source);
+    return s;
+}
 
+static mrerror shader_compile_status(uint32_t s)
+{
     int success;
     char infoLog[512];
-    glGetShaderiv(*s, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(s, GL_COMPILE_STATUS, &success);
 
     if (!success) {
-        glGetShaderInfoLog(*s, 512, NULL, infoLog);
+        glGetShaderInfoLog(s, 512, NULL, infoLog);
         printf("info %s\n\n", infoLog);
         return mrerror_new(infoLog);
     }
 
     return nilerr();
+}
+
+// GL_KHR_parallel_shader_compile, glad is generated without it
+typedef void (*max_threads_proc)(uint32_t count);
 
-err_read:
-    free(shader_source);
-    printf("xxxn\\n\n\n");
-    return mrerror_new("cant read file lmao");
+void shader_set_parallel(void *max_shader_compiler_threads)
+{
+    // let the driver pick how many compiler threads to run
+    if (max_shader_compiler_threads) {
+        ((max_threads_proc)max_shader_compiler_threads)(0xffffffffu);
+    }
 }
 
-mrerror shader_new(shader *s, const char *vert_path, const char *frag_path)
+// program binary cache, see shader_set_cache
+
+#define BINARY_MAGIC   0x4253524d // "MRSB"
+#define BINARY_VERSION 1
+
+struct binary_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t length;
+};
+
+static char binary_dir[512];
+
+void shader_set_cache(const char *dir)
 {
-    uint32_t vert, frag;
+    snprintf(binary_dir, sizeof(binary_dir), "%s", dir ? dir : "");
+}
 
-    shader_compile(&vert, GL_VERTEX_SHADER, vert_path);
-    shader_compile(&frag, GL_FRAGMENT_SHADER, frag_path);
+static uint64_t hash_str(uint64_t h, const char *str)
+{
+    h = hash_bytes(h, str, strlen(str));
 
-    *s = glCreateProgram();
-    glAttachShader(*s, vert);
-    glAttachShader(*s, frag);
-    glLinkProgram(*s);
+    // separator, so "ab" + "c" and "a" + "bc" differ
+    return hash_bytes(h, "\xff", 1);
+}
 
-    int success;
-    char infoLog[512];
-    glGetProgramiv(*s, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(*s, 512, NULL, infoLog);
-        printf("info %s\n\n", infoLog);
-        return mrerror_new(infoLog);
+// binaries are only valid for the exact driver build that produced them
+static void binary_path(const char *vert, const char *frag, char *path, size_t size)
+{
+    uint64_t h = HASH_SEED;
+
+    h = hash_str(h, vert);
+    h = hash_str(h, frag);
+    h = hash_str(h, (const char *)glGetString(GL_VENDOR));
+    h = hash_str(h, (const char *)glGetString(GL_RENDERER));
+    h = hash_str(h, (const char *)glGetString(GL_VERSION));
+
+    snprintf(path, size, "%s/%016llx.bin", binary_dir, (unsigned long long)h);
+}
+
+static int binary_load(uint32_t program, const char *path)
+{
+    struct binary_header hdr;
+    int success = 0;
+    void *data;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != BINARY_MAGIC || hdr.version != BINARY_VERSION) {
+        fclose(f);
+        return 0;
+    }
+
+    data = malloc(hdr.length);
+    if (data && fread(data, 1, hdr.length, f) == hdr.length) {
+        // a driver update makes this fail and the caller compiles again
+        glProgramBinary(program, hdr.format, data, hdr.length);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+    }
+
+    free(data);
+    fclose(f);
+
+    return success;
+}
+
+static void binary_store(uint32_t program, const char *path)
+{
+    char tmpfile[620];
+    struct binary_header hdr = {.magic = BINARY_MAGIC, .version = BINARY_VERSION};
+    GLint length;
+    GLenum format;
+    void *data;
+
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    data = malloc(length);
+    if (!data) {
+        return;
+    }
+    glGetProgramBinary(program, length, &length, &format, data);
+    hdr.format = format;
+    hdr.length = length;
+
+    // concurrent jobs sharing the cache never read a partial binary
+    fileio_temp_path(tmpfile, sizeof(tmpfile), path);
+    FILE *f = fopen(tmpfile, "wb");
+    if (f) {
+        int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 && fwrite(data, 1, length, f) == (size_t)length;
+
+        if (fclose(f) || !ok || !fileio_replace(tmpfile, path)) {
+            remove(tmpfile);
+        }
+    }
+
+    free(data);
+}
+
+static const char *slot_names[SHADER_SLOT_NUM] = {
+    [SHADER_QUANT_OFFSET] = "quant_offset",
+    [SHADER_QUANT_SCALE] = "quant_scale",
+};
+
+static void shader_reflect(shader *s)
+{
+    int count;
+    uint32_t block;
+
+    glGetProgramiv(s->program, GL_ACTIVE_UNIFORMS, &count);
+    s->uniforms = calloc(count, sizeof(shader_uniform));
+    s->uniform_num = 0;
+
+    for (int i = 0; i < count; i++) {
+        shader_uniform *u = &s->uniforms[s->uniform_num];
+        GLsizei len;
+        char *bracket;
+
+        glGetActiveUniform(s->program, i, sizeof(u->name), &len, &u->size, &u->type, u->name);
+
+        // block members have no location, they are set through the block
+        u->location = glGetUniformLocation(s->program, u->name);
+        if (u->location < 0) {
+            continue;
+        }
+
+        bracket = strchr(u->name, '[');
+        if (bracket) {
+            *bracket = 0;
+        }
+        s->uniform_num++;
+    }
+
+    for (int i = 0; i < SHADER_SLOT_NUM; i++) {
+        s->slots[i] = shader_uniform_location(s, slot_names[i]);
+    }
+
+    block = glGetUniformBlockIndex(s->program, "Camera");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(s->program, block, SHADER_CAMERA_BINDING);
+    }
+
+    block = glGetUniformBlockIndex(s->program, "Models");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(s->program, block, SHADER_MODELS_BINDING);
+        glGetActiveUniformBlockiv(s->program, block, GL_UNIFORM_BLOCK_DATA_SIZE, &s->models_size);
+    }
+
+    block = glGetUniformBlockIndex(s->program, "Quads");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(s->program, block, SHADER_QUADS_BINDING);
+        glGetActiveUniformBlockiv(s->program, block, GL_UNIFORM_BLOCK_DATA_SIZE, &s->quads_size);
+    }
+}
+
+int32_t shader_uniform_location(const shader *s, const char *name)
+{
+    for (int i = 0; i < s->uniform_num; i++) {
+        if (!strcmp(s->uniforms[i].name, name)) {
+            return s->uniforms[i].location;
+        }
+    }
+    return -1;
+}
+
+mrerror shader_begin(shader *s, const char *vert_path, const char *frag_path, const char *defines)
+{
+    char path[600];
+    char *sources[2];
+    int formats = 0;
+
+    memset(s, 0, sizeof(shader));
+
+    for (int i = 0; i < 2; i++) {
+        char *source = shader_read(i ? frag_path : vert_path);
+        if (!source) {
+            if (i) {
+                free(sources[0]);
+            }
+            return mrerror_new("cant load shader lmao");
+        }
+
+        sources[i] = shader_specialize(source, defines);
+        free(source);
+    }
+
+    s->program = glCreateProgram();
+
+    if (binary_dir[0]) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    if (formats > 0) {
+        binary_path(sources[0], sources[1], path, sizeof(path));
+
+        if (binary_load(s->program, path)) {
+            free(sources[0]);
+            free(sources[1]);
+            return nilerr();
+        }
+        glProgramParameteri(s->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        s->binary_path = strdup(path);
+    }
+
+    s->stages[0] = shader_compile(GL_VERTEX_SHADER, sources[0]);
+    s->stages[1] = shader_compile(GL_FRAGMENT_SHADER, sources[1]);
+    free(sources[0]);
+    free(sources[1]);
+
+    glAttachShader(s->program, s->stages[0]);
+    glAttachShader(s->program, s->stages[1]);
+    glLinkProgram(s->program);
+
+    return nilerr();
+}
+
+mrerror shader_finish(shader *s)
+{
+    mrerror err = nilerr();
+
+    // loaded from a binary, already linked
+    if (!s->stages[0]) {
+        shader_reflect(s);
+        return nilerr();
+    }
+
+    for (int i = 0; i < 2 && !err.err; i++) {
+        err = shader_compile_status(s->stages[i]);
+    }
+
+    if (!err.err) {
+        int success;
+        char infoLog[512];
+        glGetProgramiv(s->program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(s->program, 512, NULL, infoLog);
+            printf("info %s\n\n", infoLog);
+            err = mrerror_new(infoLog);
+        }
+    }
+
+    glDeleteShader(s->stages[0]);
+    glDeleteShader(s->stages[1]);
+    s->stages[0] = s->stages[1] = 0;
+
+    if (!err.err && s->binary_path) {
+        binary_store(s->program, s->binary_path);
+    }
+    free(s->binary_path);
+    s->binary_path = NULL;
+
+    if (err.err) {
+        return err;
     }
 
-    glDeleteShader(vert);
-    glDeleteShader(frag);
+    shader_reflect(s);
 
     return nilerr();
 }
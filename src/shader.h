@@ -5,8 +5,64 @@
 
 #include "error.h"
 
-typedef uint32_t shader;
+// uniform block bindings, see camera_update and camera_transform_mesh
+#define SHADER_CAMERA_BINDING 0
+#define SHADER_MODELS_BINDING 1
+#define SHADER_QUADS_BINDING  2
 
-mrerror shader_new(shader *s, const char *vert, const char *frag);
+// uniforms the render loop sets every frame, resolved once at link time
+enum {
+    SHADER_QUANT_OFFSET,
+    SHADER_QUANT_SCALE,
+    SHADER_SLOT_NUM
+};
+
+typedef struct shader_uniform {
+    char     name[64];  // arrays without the [0] suffix
+    int32_t  location;
+    uint32_t type;
+    int32_t  size;
+} shader_uniform;
+
+// Program plus the reflection of its active uniforms. slots hold the
+// locations of the per-frame uniforms, -1 when the program lacks one.
+typedef struct shader {
+    uint32_t program;
+
+    shader_uniform *uniforms;
+    int             uniform_num;
+
+    int32_t slots[SHADER_SLOT_NUM];
+
+    // data size of the Models block, every range bound to it must cover it
+    int32_t models_size;
+    // same for the Quads block of the background pass
+    int32_t quads_size;
+
+    // between shader_begin and shader_finish
+    uint32_t stages[2];
+    char    *binary_path;
+} shader;
+
+// defines is a space separated list of feature toggles, each one is
+// #defined in both stages before compiling.
+//
+// Building a program takes two calls: begin submits the compile and link
+// without waiting, finish checks the result and reflects the program.
+// Work done in between overlaps with the driver's compiler threads.
+mrerror shader_begin(shader *s, const char *vert, const char *frag, const char *defines);
+mrerror shader_finish(shader *s);
+
+// glMaxShaderCompilerThreadsKHR or ARB when the driver has one of the
+// parallel_shader_compile extensions, NULL otherwise
+void shader_set_parallel(void *max_shader_compiler_threads);
+
+// Linked programs are saved to dir with glGetProgramBinary and loaded from
+// there on later runs, keyed by the specialized sources and the GL vendor,
+// renderer and version strings. Empty or NULL disables the cache.
+void shader_set_cache(const char *dir);
+
+// table lookup for setup code, -1 when absent
+int32_t shader_uniform_location(const shader *s, const char *name);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include "simplify.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+struct collapse {
+    uint32_t from, to;
+    float    cost;
+};
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int compare_cost(const void *a, const void *b)
+{
+    float x = ((const struct collapse *)a)->cost;
+    float y = ((const struct collapse *)b)->cost;
+
+    return (x > y) - (x < y);
+}
+
+// q is the upper triangle of the symmetric 4x4 plane quadric
+static void quadric_add_plane(double *q, const double *p, double w)
+{
+    q[0] += w*p[0]*p[0]; q[1] += w*p[0]*p[1]; q[2] += w*p[0]*p[2]; q[3] += w*p[0]*p[3];
+    q[4] += w*p[1]*p[1]; q[5] += w*p[1]*p[2]; q[6] += w*p[1]*p[3];
+    q[7] += w*p[2]*p[2]; q[8] += w*p[2]*p[3];
+    q[9] += w*p[3]*p[3];
+}
+
+static double quadric_eval(const double *a, const double *b, const float *v)
+{
+    double q[10];
+    double x = v[0], y = v[1], z = v[2];
+
+    for (int i = 0; i < 10; i++) {
+        q[i] = a[i] + b[i];
+    }
+
+    return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x
+         + q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y
+         + q[7]*z*z + 2*q[8]*z
+         + q[9];
+}
+
+static void triangle_normal(const float *a, const float *b, const float *c, vec3 n)
+{
+    vec3 e1, e2;
+
+    glm_vec3_sub((float *)b, (float *)a, e1);
+    glm_vec3_sub((float *)c, (float *)a, e2);
+    glm_vec3_cross(e1, e2, n);
+}
+
+mrerror simplifier_new(simplifier *s, const vertex *vertices, uint32_t vert_num,
+                       const uint32_t *indices, const uint32_t *groups, uint32_t tri_num)
+{
+    memset(s, 0, sizeof(simplifier));
+    s->vertices = vertices;
+    s->vert_num = vert_num;
+    s->tri_num = tri_num;
+
+    s->indices = malloc((size_t)tri_num * 3 * sizeof(uint32_t));
+    s->groups = malloc((size_t)tri_num * sizeof(uint32_t));
+    s->quadrics = calloc((size_t)vert_num * 10, sizeof(double));
+    s->weights = calloc(vert_num, sizeof(double));
+    s->locked = calloc(vert_num, 1);
+
+    uint64_t *edges = malloc((size_t)tri_num * 3 * sizeof(uint64_t));
+    uint32_t *vertex_group = malloc(vert_num * sizeof(uint32_t));
+
+    if (!s->indices || !s->groups || !s->quadrics || !s->weights || !s->locked || !edges || !vertex_group) {
+        free(edges);
+        free(vertex_group);
+        simplifier_free(s);
+        return mrerror_new("malloc error");
+    }
+
+    memcpy(s->indices, indices, (size_t)tri_num * 3 * sizeof(uint32_t));
+    memcpy(s->groups, groups, (size_t)tri_num * sizeof(uint32_t));
+    memset(vertex_group, 0xff, vert_num * sizeof(uint32_t));
+
+    for (uint32_t t = 0; t < tri_num; t++) {
+        const uint32_t *i = &s->indices[t*3];
+        vec3 n;
+
+        triangle_normal(vertices[i[0]].position, vertices[i[1]].position, vertices[i[2]].position, n);
+
+        float area2 = glm_vec3_norm(n);
+        if (area2 > 0) {
+            double plane[4] = {n[0]/area2, n[1]/area2, n[2]/area2, 0};
+            plane[3] = -(plane[0]*vertices[i[0]].position[0] +
+                         plane[1]*vertices[i[0]].position[1] +
+                         plane[2]*vertices[i[0]].position[2]);
+
+            for (int k = 0; k < 3; k++) {
+                quadric_add_plane(&s->quadrics[i[k]*10], plane, area2 / 2);
+                s->weights[i[k]] += area2 / 2;
+            }
+        }
+
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = i[k], b = i[(k + 1) % 3];
+
+            edges[t*3 + k] = a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+
+            // material edges stay where they are
+            if (vertex_group[a] == UINT32_MAX) {
+                vertex_group[a] = groups[t];
+            }
+            else if (vertex_group[a] != groups[t]) {
+                s->locked[a] = 1;
+            }
+        }
+    }
+
+    // an edge without exactly two triangles is a border or a seam
+    qsort(edges, (size_t)tri_num * 3, sizeof(uint64_t), compare_u64);
+    for (size_t e = 0; e < (size_t)tri_num * 3;) {
+        size_t run = 1;
+
+        while (e + run < (size_t)tri_num * 3 && edges[e + run] == edges[e]) {
+            run++;
+        }
+        if (run != 2) {
+            s->locked[edges[e] >> 32] = 1;
+            s->locked[edges[e] & 0xffffffff] = 1;
+        }
+        e += run;
+    }
+
+    free(edges);
+    free(vertex_group);
+
+    return nilerr();
+}
+
+void simplifier_free(simplifier *s)
+{
+    free(s->indices);
+    free(s->groups);
+    free(s->quadrics);
+    free(s->weights);
+    free(s->locked);
+    memset(s, 0, sizeof(simplifier));
+}
+
+// moving from onto to must not turn any remaining triangle around
+static int flips(const simplifier *s, const uint32_t *adjacency, const uint32_t *offsets, uint32_t from, uint32_t to)
+{
+    for (uint32_t k = offsets[from]; k < offsets[from + 1]; k++) {
+        const uint32_t *i = &s->indices[adjacency[k]*3];
+        const float *p[3], *q[3];
+        vec3 before, after;
+
+        if (i[0] == to || i[1] == to || i[2] == to) {
+            continue;
+        }
+
+        for (int j = 0; j < 3; j++) {
+            p[j] = s->vertices[i[j]].position;
+            q[j] = i[j] == from ? s->vertices[to].position : p[j];
+        }
+
+        triangle_normal(p[0], p[1], p[2], before);
+        triangle_normal(q[0], q[1], q[2], after);
+        if (glm_vec3_dot(before, after) <= 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// one round of independent collapses, cheapest first; returns how many
+static uint32_t simplify_pass(simplifier *s, uint32_t target)
+{
+    uint32_t *offsets = calloc(s->vert_num + 1, sizeof(uint32_t));
+    uint32_t *adjacency = malloc((size_t)s->tri_num * 3 * sizeof(uint32_t));
+    uint32_t *remap = malloc(s->vert_num * sizeof(uint32_t));
+    uint8_t *touched = calloc(s->vert_num, 1);
+    struct collapse *candidates = malloc((size_t)s->tri_num * 6 * sizeof(struct collapse));
+    size_t candidate_num = 0;
+    uint32_t collapsed = 0;
+
+    if (!offsets || !adjacency || !remap || !touched || !candidates) {
+        goto out;
+    }
+
+    // vertex to triangles
+    for (uint32_t t = 0; t < s->tri_num * 3; t++) {
+        offsets[s->indices[t] + 1]++;
+    }
+    for (uint32_t v = 0; v < s->vert_num; v++) {
+        offsets[v + 1] += offsets[v];
+        remap[v] = offsets[v];
+    }
+    // remap is the fill cursor until the collapses start
+    for (uint32_t t = 0; t < s->tri_num; t++) {
+        for (int k = 0; k < 3; k++) {
+            adjacency[remap[s->indices[t*3 + k]]++] = t;
+        }
+    }
+    for (uint32_t v = 0; v < s->vert_num; v++) {
+        remap[v] = v;
+    }
+
+    for (uint32_t t = 0; t < s->tri_num; t++) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = s->indices[t*3 + k];
+            uint32_t b = s->indices[t*3 + (k + 1) % 3];
+
+            if (!s->locked[a]) {
+                double w = s->weights[a] + s->weights[b];
+                double cost = quadric_eval(&s->quadrics[a*10], &s->quadrics[b*10], s->vertices[b].position);
+                candidates[candidate_num++] = (struct collapse){a, b, (float)(w > 0 ? fabs(cost) / w : 0)};
+            }
+            if (!s->locked[b]) {
+                double w = s->weights[a] + s->weights[b];
+                double cost = quadric_eval(&s->quadrics[a*10], &s->quadrics[b*10], s->vertices[a].position);
+                candidates[candidate_num++] = (struct collapse){b, a, (float)(w > 0 ? fabs(cost) / w : 0)};
+            }
+        }
+    }
+    qsort(candidates, candidate_num, sizeof(struct collapse), compare_cost);
+
+    uint32_t goal = s->tri_num - target;
+    uint32_t removed = 0;
+
+    for (size_t c = 0; c < candidate_num && removed < goal; c++) {
+        uint32_t from = candidates[c].from, to = candidates[c].to;
+
+        if (touched[from] || touched[to]) {
+            continue;
+        }
+        if (flips(s, adjacency, offsets, from, to)) {
+            continue;
+        }
+
+        remap[from] = to;
+        for (int i = 0; i < 10; i++) {
+            s->quadrics[to*10 + i] += s->quadrics[from*10 + i];
+        }
+        s->weights[to] += s->weights[from];
+        if (sqrtf(candidates[c].cost) > s->error) {
+            s->error = sqrtf(candidates[c].cost);
+        }
+
+        // the ring around from changes, nothing in it moves again this pass
+        for (uint32_t k = offsets[from]; k < offsets[from + 1]; k++) {
+            const uint32_t *i = &s->indices[adjacency[k]*3];
+
+            removed += i[0] == to || i[1] == to || i[2] == to;
+            touched[i[0]] = touched[i[1]] = touched[i[2]] = 1;
+        }
+        collapsed++;
+    }
+
+    // drop the triangles that lost an edge, keeping the order
+    uint32_t kept = 0;
+    for (uint32_t t = 0; t < s->tri_num; t++) {
+        uint32_t a = remap[s->indices[t*3]];
+        uint32_t b = remap[s->indices[t*3 + 1]];
+        uint32_t c = remap[s->indices[t*3 + 2]];
+
+        if (a == b || b == c || c == a) {
+            continue;
+        }
+
+        s->indices[kept*3] = a;
+        s->indices[kept*3 + 1] = b;
+        s->indices[kept*3 + 2] = c;
+        s->groups[kept] = s->groups[t];
+        kept++;
+    }
+    s->tri_num = kept;
+
+out:
+    free(offsets);
+    free(adjacency);
+    free(remap);
+    free(touched);
+    free(candidates);
+
+    return collapsed;
+}
+
+uint32_t simplifier_run(simplifier *s, uint32_t target)
+{
+    while (s->tri_num > target) {
+        if (simplify_pass(s, target) == 0) {
+            break;
+        }
+    }
+
+    return s->tri_num;
+}
@@ -0,0 +1,40 @@
+#ifndef __SIMPLIFY_H__
+#define __SIMPLIFY_H__
+
+#include <stdint.h>
+
+#include "error.h"
+#include "mesh.h"
+
+// Quadric error edge collapse over an indexed triangle list. Vertices are
+// never moved or created, a collapse points every use of one vertex at a
+// neighbour, so uvs and normals stay valid. Vertices on open edges (mesh
+// borders, uv and normal seams) and vertices shared by two groups never
+// collapse, which keeps outlines and material edges intact.
+//
+// Quadrics carry over between runs, so repeated runs build a chain of
+// ever coarser levels measured against the original surface.
+typedef struct simplifier {
+    const vertex *vertices;
+    uint32_t      vert_num;
+
+    uint32_t *indices;  // current triangles, in their original order
+    uint32_t *groups;   // per triangle, e.g. the surface
+    uint32_t  tri_num;
+
+    double  *quadrics;  // 10 per vertex, area weighted
+    double  *weights;
+    uint8_t *locked;
+
+    float error;        // largest collapse so far, a model space distance
+} simplifier;
+
+mrerror simplifier_new(simplifier *s, const vertex *vertices, uint32_t vert_num,
+                       const uint32_t *indices, const uint32_t *groups, uint32_t tri_num);
+void simplifier_free(simplifier *s);
+
+// collapses until at most target triangles are left or nothing else can
+// go, returns the triangle count
+uint32_t simplifier_run(simplifier *s, uint32_t target);
+
+#endif
@@ -0,0 +1,126 @@
+#include "spritecache.h"
+#include "fileio.h"
+#include "hash.h"
+
+#include <stdio.h>
+#include <string.h>
+
+struct sprite_header {
+    uint32_t magic;
+    uint32_t version;
+    int32_t  w, h;
+    uint32_t annotation_size;
+};
+
+static mrerror hash_file(uint64_t *h, const char *path)
+{
+    uint8_t buf[1 << 16];
+    size_t n;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return mrerror_new("can't hash sprite cache input");
+    }
+
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        *h = hash_bytes(*h, buf, n);
+    }
+    fclose(f);
+
+    return nilerr();
+}
+
+mrerror sprite_cache_open(sprite_cache *c, const char *root, const char *const *files, int file_count,
+                          const void *params, size_t params_size, int w, int h)
+{
+    uint64_t key = HASH_SEED;
+    mrerror err;
+
+    for (int i = 0; i < file_count; i++) {
+        if (!files[i] || !files[i][0]) {
+            continue;
+        }
+
+        err = hash_file(&key, files[i]);
+        if (err.err) {
+            return err;
+        }
+    }
+    key = hash_bytes(key, params, params_size);
+
+    snprintf(c->dir, sizeof(c->dir), "%s/%016llx", root, (unsigned long long)key);
+    c->w = w;
+    c->h = h;
+
+    return nilerr();
+}
+
+static void sprite_path(const sprite_cache *c, const pose *p, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%g_%g.spr", c->dir, p->yaw, p->pitch);
+}
+
+int sprite_cache_load(const sprite_cache *c, const pose *p, annotation *a, uint8_t *rgba)
+{
+    char path[1100];
+    struct sprite_header hdr;
+    size_t size = (size_t)c->w * c->h * 4;
+    int ok;
+
+    sprite_path(c, p, path, sizeof(path));
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+
+    ok = fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+         hdr.magic == SPRITE_MAGIC && hdr.version == SPRITE_VERSION &&
+         hdr.w == c->w && hdr.h == c->h && hdr.annotation_size == sizeof(annotation) &&
+         fread(a, sizeof(annotation), 1, f) == 1 &&
+         fread(rgba, 1, size, f) == size;
+    fclose(f);
+
+    return ok;
+}
+
+mrerror sprite_cache_store(const sprite_cache *c, const pose *p, const annotation *a, const uint8_t *rgba, int stride)
+{
+    char path[1100];
+    char tmpfile[1120];
+    struct sprite_header hdr = {
+        .magic = SPRITE_MAGIC,
+        .version = SPRITE_VERSION,
+        .w = c->w,
+        .h = c->h,
+        .annotation_size = sizeof(annotation),
+    };
+    int ok;
+
+    sprite_path(c, p, path, sizeof(path));
+    fileio_temp_path(tmpfile, sizeof(tmpfile), path);
+
+    FILE *f = fopen(tmpfile, "wb");
+    if (!f) {
+        return mrerror_new("can't write sprite");
+    }
+
+    ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+         fwrite(a, sizeof(annotation), 1, f) == 1;
+    for (int y = 0; ok && y < c->h; y++) {
+        ok = fwrite(rgba + (size_t)y * stride, 4, c->w, f) == (size_t)c->w;
+    }
+
+    if (fclose(f) || !ok) {
+        remove(tmpfile);
+        return mrerror_new("can't write sprite");
+    }
+
+    // concurrent runs sharing a cache only ever see whole sprites
+    if (!fileio_replace(tmpfile, path)) {
+        remove(tmpfile);
+        return mrerror_new("can't write sprite");
+    }
+
+    return nilerr();
+}
@@ -0,0 +1,37 @@
+#ifndef __SPRITECACHE_H__
+#define __SPRITECACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error.h"
+#include "annotation.h"
+#include "pose.h"
+
+#define SPRITE_MAGIC   0x5053524d // "MRSP"
+#define SPRITE_VERSION 1
+
+// Rendered object sprites reused across runs. A sprite is the premultiplied
+// RGBA of one pose over transparent black, alpha being the coverage mask,
+// stored raw next to its annotation.
+//
+// Sprites live in <root>/<key>/<yaw>_<pitch>.spr where key hashes every
+// input that changes the pixels: model, texture and shader sources plus
+// the render parameters. Anything else changing, backgrounds included,
+// keeps the cache valid.
+typedef struct sprite_cache {
+    char dir[1024];
+    int w, h;
+} sprite_cache;
+
+// files are hashed by content, params by value
+mrerror sprite_cache_open(sprite_cache *c, const char *root, const char *const *files, int file_count,
+                          const void *params, size_t params_size, int w, int h);
+
+// 1 and the sprite on a hit, 0 when absent or unreadable
+int sprite_cache_load(const sprite_cache *c, const pose *p, annotation *a, uint8_t *rgba);
+
+// rgba rows are stride bytes apart
+mrerror sprite_cache_store(const sprite_cache *c, const pose *p, const annotation *a, const uint8_t *rgba, int stride);
+
+#endif
@@ -0,0 +1,82 @@
+#include "stream.h"
+
+#include <glad/glad.h>
+#include <string.h>
+
+static size_t align_up(size_t v, size_t align)
+{
+    return (v + align - 1) / align * align;
+}
+
+mrerror stream_new(stream_buffer *sb, size_t slot_size)
+{
+    GLint align;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    memset(sb, 0, sizeof(stream_buffer));
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    sb->align = align > 0 ? align : 256;
+    sb->slot_size = align_up(slot_size, sb->align);
+
+    glCreateBuffers(1, &sb->buffer);
+    glNamedBufferStorage(sb->buffer, sb->slot_size * STREAM_SLOTS, NULL, flags);
+
+    sb->data = glMapNamedBufferRange(sb->buffer, 0, sb->slot_size * STREAM_SLOTS, flags);
+    if (!sb->data) {
+        glDeleteBuffers(1, &sb->buffer);
+        return mrerror_new("can't map stream buffer");
+    }
+
+    return nilerr();
+}
+
+void stream_free(stream_buffer *sb)
+{
+    for (int i = 0; i < STREAM_SLOTS; i++) {
+        if (sb->fences[i]) {
+            glDeleteSync(sb->fences[i]);
+        }
+    }
+
+    glUnmapNamedBuffer(sb->buffer);
+    glDeleteBuffers(1, &sb->buffer);
+    memset(sb, 0, sizeof(stream_buffer));
+}
+
+void stream_next(stream_buffer *sb)
+{
+    if (sb->used == 0) {
+        return;
+    }
+
+    sb->fences[sb->slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    sb->slot = (sb->slot + 1) % STREAM_SLOTS;
+    sb->used = 0;
+
+    // the slot is free once the GPU has finished the draws that read it
+    GLsync fence = sb->fences[sb->slot];
+    if (fence) {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+        glDeleteSync(fence);
+        sb->fences[sb->slot] = NULL;
+    }
+}
+
+void *stream_alloc(stream_buffer *sb, size_t size, size_t *offset)
+{
+    size = align_up(size, sb->align);
+    if (size > sb->slot_size) {
+        return NULL;
+    }
+
+    if (sb->used + size > sb->slot_size) {
+        stream_next(sb);
+    }
+
+    *offset = sb->slot * sb->slot_size + sb->used;
+    sb->used += size;
+
+    return sb->data + *offset;
+}
@@ -0,0 +1,39 @@
+#ifndef __STREAM_H__
+#define __STREAM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error.h"
+
+#define STREAM_SLOTS 3
+
+// Ring of STREAM_SLOTS slots in one persistently mapped, coherent buffer.
+// The CPU fills one slot while the GPU may still read the others; a fence
+// placed when a slot is closed is waited on before the ring comes back
+// to it. Nothing is reallocated or orphaned once the buffer exists.
+typedef struct stream_buffer {
+    uint32_t buffer;
+    uint8_t *data;
+
+    size_t slot_size;
+    size_t align;
+
+    int    slot;  // being written
+    size_t used;  // bytes of the current slot
+
+    void *fences[STREAM_SLOTS];
+} stream_buffer;
+
+// allocations are aligned for glBindBufferRange on GL_UNIFORM_BUFFER
+mrerror stream_new(stream_buffer *sb, size_t slot_size);
+void stream_free(stream_buffer *sb);
+
+// size bytes of the current slot, moving to the next one when it is full;
+// NULL only when size exceeds a whole slot
+void *stream_alloc(stream_buffer *sb, size_t size, size_t *offset);
+
+// fences the current slot after the draws reading it were issued
+void stream_next(stream_buffer *sb);
+
+#endif
@@ -7,88 +7,111 @@
 #include <stb_image.h>
 
 #include "error.h"
+#include "glstate.h"
 
-struct texture_entry
+// nearest neighbour, only hit by mismatched material sizes
+static void resample(const uint8_t *src, int sw, int sh, uint8_t *dst, int dw, int dh)
 {
-    char *name;
-    texture t;
+    for (int y = 0; y < dh; y++) {
+        const uint8_t *row = src + (size_t)(y * sh / dh) * sw * 4;
 
-    struct texture_entry *next;
-} textures_head = {0};
+        for (int x = 0; x < dw; x++) {
+            memcpy(dst + ((size_t)y * dw + x) * 4, row + (size_t)(x * sw / dw) * 4, 4);
+        }
+    }
+}
 
-mrerror texture_new(texture *t, const char *file)
+mrerror texture_new_array(texture *t, const char *const *files, int count)
 {
-    int w, h, comp;
-    int name_len;
-    struct texture_entry *temp;
-    struct texture_entry *entry;
-
-    uint8_t *data = stbi_load(file, &w, &h, &comp, 4);
-    if (data == NULL) {
-        stbi_image_free(data);
-        printf("KEKEKEKEKEKK LMFAO\n");
-        return mrerror_new(stbi_failure_reason());
-    }
+    int w = 0, h = 0;
+    uint8_t *layer = NULL;
 
     glGenTextures(1, t);
-    glBindTexture(GL_TEXTURE_2D, *t);
+    glstate_bind_texture(0, GL_TEXTURE_2D_ARRAY, *t);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    for (int i = 0; i < count; i++) {
+        int iw, ih, comp;
 
-    stbi_image_free(data);
+        uint8_t *data = stbi_load(files[i], &iw, &ih, &comp, 4);
+        if (data == NULL) {
+            free(layer);
+            glDeleteTextures(1, t);
+            return mrerror_new(stbi_failure_reason());
+        }
 
-    temp = &textures_head;
-    while (temp->next) {
-        temp = temp->next;
-    }
+        if (i == 0) {
+            w = iw;
+            h = ih;
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, w, h, count, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            layer = malloc((size_t)w * h * 4);
+        }
 
-    temp->next = malloc(sizeof(struct texture_entry));
-    
-    entry = temp->next;
+        if (iw == w && ih == h) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        }
+        else {
+            resample(data, iw, ih, layer, w, h);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, layer);
+        }
 
-    name_len = strlen(file);
-    entry->name = malloc(name_len + 1);
-    entry->name[name_len] = 0;
-    strcpy(entry->name, file);
+        stbi_image_free(data);
+    }
 
-    entry->t = *t;
-    entry->next = 0;
+    free(layer);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
 
     return nilerr();
 }
 
-mrerror texture_find(texture *t, const char *name)
+mrerror texture_new_array_sized(texture *t, const char *const *files, int count, int w, int h)
 {
-    struct texture_entry *temp;
-    
-    temp = textures_head.next;
-    while (temp) {
-        if (!strcmp(temp->name, name)) {
-            *t = temp->t;
-
-            return nilerr();
-        }
-        temp = temp->next;
+    int max_layers;
+    uint32_t fbo[2];
+
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    if (count > max_layers) {
+        return mrerror_new("too many layers for a texture array");
     }
-    return texture_new(t, name);
-}
 
-void texture_free_all()
-{
-    struct texture_entry *entry;
-    struct texture_entry *temp;
-    
-    entry = textures_head.next;
-    while (entry->next) {
-        temp = entry;
-        entry = entry->next;
-
-        free(temp);
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, t);
+    glTextureParameteri(*t, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(*t, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(*t, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(*t, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureStorage3D(*t, 1, GL_RGBA8, w, h, count);
+
+    // read and draw framebuffers of the blit, no binding changes
+    glCreateFramebuffers(2, fbo);
+
+    for (int i = 0; i < count; i++) {
+        int iw, ih, comp;
+        uint32_t src;
+
+        uint8_t *data = stbi_load(files[i], &iw, &ih, &comp, 4);
+        if (data == NULL) {
+            glDeleteFramebuffers(2, fbo);
+            glDeleteTextures(1, t);
+            return mrerror_new(stbi_failure_reason());
+        }
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &src);
+        glTextureStorage2D(src, 1, GL_RGBA8, iw, ih);
+        glTextureSubImage2D(src, 0, 0, 0, iw, ih, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        stbi_image_free(data);
+
+        glNamedFramebufferTexture(fbo[0], GL_COLOR_ATTACHMENT0, src, 0);
+        glNamedFramebufferTextureLayer(fbo[1], GL_COLOR_ATTACHMENT0, *t, 0, i);
+        glBlitNamedFramebuffer(fbo[0], fbo[1], 0, 0, iw, ih, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+        glDeleteTextures(1, &src);
     }
+
+    glDeleteFramebuffers(2, fbo);
+
+    return nilerr();
 }
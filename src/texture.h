@@ -7,8 +7,13 @@
 
 typedef uint32_t texture;
 
-mrerror texture_new(texture *t, const char *file);
+// GL_TEXTURE_2D_ARRAY with one layer per file, sized after the first one.
+// Layers of another size are resampled to fit.
+mrerror texture_new_array(texture *t, const char *const *files, int count);
 
-mrerror texture_find(texture *t, const char *name);
+// GL_TEXTURE_2D_ARRAY of w x h layers, each file scaled to fit on the GPU
+// with a linear blit. Without mipmaps, meant to be sampled at its own size.
+// count is at most GL_MAX_ARRAY_TEXTURE_LAYERS.
+mrerror texture_new_array_sized(texture *t, const char *const *files, int count, int w, int h);
 
 #endif
\ No newline at end of file